@@ -0,0 +1,59 @@
+#!/bin/bash
+# Time from starting gol until the GNTP port accepts a connection, which is
+# what deferring the migration and history setup shortens.
+#
+#   bench/startup.sh [gol binary] [runs] [config.db to start from]
+#
+# Every run starts from a copy of the given config.db (by default a fresh
+# one), so an old database goes through its migration each time. Prints
+# each run and the median, in milliseconds. Needs a display for GTK, e.g.
+# run it under xvfb-run.
+
+GOL=${1:-./gol}
+RUNS=${2:-10}
+SEED=$3
+PORT=23053
+
+now_ms() {
+  echo $(( $(date +%s%N) / 1000000 ))
+}
+
+listening() {
+  (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null
+}
+
+if listening; then
+  echo "something already listens on $PORT" >&2
+  exit 1
+fi
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+n=0
+: > "$WORK/times"
+while [ $n -lt "$RUNS" ]; do
+  rm -rf "$WORK/config"
+  mkdir -p "$WORK/config/gol"
+  [ -n "$SEED" ] && cp "$SEED" "$WORK/config/gol/config.db"
+
+  start=$(now_ms)
+  XDG_CONFIG_HOME="$WORK/config" "$GOL" >/dev/null 2>&1 &
+  pid=$!
+  until listening; do
+    if ! kill -0 $pid 2>/dev/null; then
+      echo "gol exited before listening" >&2
+      exit 1
+    fi
+    sleep 0.005
+  done
+  elapsed=$(( $(now_ms) - start ))
+  kill $pid
+  wait $pid 2>/dev/null
+
+  echo "run $n: $elapsed ms"
+  echo $elapsed >> "$WORK/times"
+  n=$((n + 1))
+done
+
+sort -n "$WORK/times" | awk '{ t[NR] = $1 } END { print "median: " t[int((NR + 1) / 2)] " ms" }'
@@ -0,0 +1,259 @@
+/* Copyright 2011 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Milliseconds from opening config.db until gol could start listening,
+// as far as the database goes; GTK and the plugins are left out, so it
+// runs without a display, unlike bench/startup.sh. "before" is load_config()
+// as it used to be: the migration ran there, each statement committed on
+// its own, ahead of the listeners. "after" only reads the config table and
+// opens the readers; the migration, timed separately, then runs in one
+// transaction on a thread of its own.
+//
+//   make startup_bench
+//   ./startup_bench [dir] [runs] [history rows]
+//
+// Every run starts from a new database ("new") and from one of an older
+// version with `history rows` notifications ("upgrade"). Files in `dir`
+// are replaced.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "db_pool.h"
+
+static const char* const migration_sqls[] = {
+  "drop table _notification",
+  "drop table _application",
+  "drop table _subscriber",
+  "drop table _display",
+  "alter table application rename to _application",
+  "alter table subscriber rename to _subscriber",
+  "alter table display rename to _display",
+  "create table notification("
+      "title text not null,"
+      "text text not null,"
+      "icon text,"
+      "url text,"
+      "received timestamp not null)",
+  "create table application("
+      "app_name text not null,"
+      "app_icon text not null,"
+      "name text not null,"
+      "icon text not null,"
+      "enable int not null,"
+      "display text not null,"
+      "sticky int not null,"
+      "primary key(app_name, name))",
+  "create table subscriber("
+      "name text not null primary key,"
+      "enable int not null)",
+  "create table display("
+      "name text not null primary key,"
+      "parameter text)",
+  "insert into notification from select * from _notification",
+  "insert into application from select * from _application",
+  "insert into subscriber from select * from _subscriber",
+  "insert into display from select * from _display",
+  "drop table _notification",
+  "drop table _application",
+  "drop table _subscriber",
+  "drop table _display",
+  NULL
+};
+
+static gchar*
+query_string(sqlite3* const db, const char* const sql) {
+  sqlite3_stmt* stmt;
+  gchar* value = NULL;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+      value = g_strdup((const char*) sqlite3_column_text(stmt, 0));
+    sqlite3_finalize(stmt);
+  }
+  return value;
+}
+
+static void
+seed(const gchar* const path, const gboolean upgrade, const gint rows) {
+  unlink(path);
+  gchar* const wal = g_strconcat(path, "-wal", NULL);
+  gchar* const shm = g_strconcat(path, "-shm", NULL);
+  unlink(wal);
+  unlink(shm);
+  g_free(wal);
+  g_free(shm);
+  if (!upgrade) return;
+
+  sqlite3* db;
+  sqlite3_open(path, &db);
+  sqlite3_exec(db,
+      "begin;"
+      "create table config(key text not null primary key, value text not null);"
+      "insert into config values('version', '0.5.0');"
+      "insert into config values('default_display', 'Fog');"
+      "create table notification(title text not null, text text not null,"
+      " icon text, url text, received timestamp not null);"
+      "create table application(app_name text not null, app_icon text not null,"
+      " name text not null, icon text not null, enable int not null,"
+      " display text not null, sticky int not null, primary key(app_name, name));"
+      "create table subscriber(name text not null primary key, enable int not null);"
+      "create table display(name text not null primary key, parameter text);"
+      "insert into display values('Fog', '');",
+      NULL, NULL, NULL);
+  sqlite3_stmt* stmt;
+  sqlite3_prepare_v2(db, "insert into notification values(?, ?, '', '', '2011-01-01 00:00:00')",
+      -1, &stmt, NULL);
+  for (gint n = 0; n < rows; n++) {
+    gchar title[64];
+    g_snprintf(title, sizeof(title), "Build %d finished", n);
+    sqlite3_bind_text(stmt, 1, title, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, "All 1234 tests passed on branch master", -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  for (gint n = 0; n < 50; n++) {
+    gchar* const sql = sqlite3_mprintf(
+        "insert into application values('App %d', '', 'Event', '', 1, 'Fog', 0)", n);
+    sqlite3_exec(db, sql, NULL, NULL, NULL);
+    sqlite3_free(sql);
+  }
+  sqlite3_exec(db, "commit", NULL, NULL, NULL);
+  sqlite3_close(db);
+}
+
+static double
+before(const gchar* const path) {
+  const gint64 started = g_get_monotonic_time();
+  const gboolean exist = g_file_test(path, G_FILE_TEST_EXISTS);
+  sqlite3* db;
+  sqlite3_open(path, &db);
+  if (!exist)
+    sqlite3_exec(db, "create table config"
+        "(key text not null primary key, value text not null)", NULL, NULL, NULL);
+  gchar* const version = query_string(db, "select value from config where key = 'version'");
+  if (g_strcmp0(version, PACKAGE_VERSION)) {
+    for (const char* const* sql = migration_sqls; *sql; ++sql)
+      sqlite3_exec(db, *sql, NULL, NULL, NULL);
+    sqlite3_exec(db, "delete from config where key = 'version'", NULL, NULL, NULL);
+    char* const sql = sqlite3_mprintf(
+        "insert into config(key, value) values('version', %Q)", PACKAGE_VERSION);
+    sqlite3_exec(db, sql, NULL, NULL, NULL);
+    sqlite3_free(sql);
+  }
+  g_free(version);
+  g_free(query_string(db, "select value from config where key = 'password'"));
+  g_free(query_string(db, "select value from config where key = 'require_password_for_local_apps'"));
+  g_free(query_string(db, "select value from config where key = 'require_password_for_lan_apps'"));
+  const double elapsed = (g_get_monotonic_time() - started) / 1000.0;
+  sqlite3_close(db);
+  return elapsed;
+}
+
+static double
+after(const gchar* const path, double* const migration) {
+  const gint64 started = g_get_monotonic_time();
+  const gboolean exist = g_file_test(path, G_FILE_TEST_EXISTS);
+  sqlite3* db;
+  sqlite3_open(path, &db);
+  sqlite3_busy_timeout(db, 5000);
+  sqlite3_exec(db, "pragma journal_mode=wal", NULL, NULL, NULL);
+  if (!exist)
+    sqlite3_exec(db, "create table config"
+        "(key text not null primary key, value text not null)", NULL, NULL, NULL);
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(db, "select key, value from config", -1, &stmt, NULL) == SQLITE_OK) {
+    while (sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_finalize(stmt);
+  }
+  DB_POOL* const readers = db_pool_new(path, 3, NULL);
+  const double elapsed = (g_get_monotonic_time() - started) / 1000.0;
+
+  const gint64 migrating = g_get_monotonic_time();
+  sqlite3* mdb;
+  sqlite3_open(path, &mdb);
+  sqlite3_busy_timeout(mdb, 5000);
+  sqlite3_exec(mdb, "begin immediate", NULL, NULL, NULL);
+  for (const char* const* sql = migration_sqls; *sql; ++sql)
+    sqlite3_exec(mdb, *sql, NULL, NULL, NULL);
+  char* const sql = sqlite3_mprintf(
+      "insert or replace into config(key, value) values('version', %Q)", PACKAGE_VERSION);
+  sqlite3_exec(mdb, sql, NULL, NULL, NULL);
+  sqlite3_free(sql);
+  sqlite3_exec(mdb, "commit", NULL, NULL, NULL);
+  sqlite3_close(mdb);
+  *migration = (g_get_monotonic_time() - migrating) / 1000.0;
+
+  if (readers) db_pool_free(readers);
+  sqlite3_close(db);
+  return elapsed;
+}
+
+static int
+compare_double(const void* a, const void* b) {
+  const double x = *(const double*) a, y = *(const double*) b;
+  return x < y ? -1 : x > y;
+}
+
+static double
+median(double* const times, const gint count) {
+  qsort(times, count, sizeof(double), compare_double);
+  return times[count / 2];
+}
+
+int
+main(int argc, char* argv[]) {
+  const gchar* const dir = argc > 1 ? argv[1] : ".";
+  const gint runs = argc > 2 ? MAX(atoi(argv[2]), 1) : 10;
+  const gint rows = argc > 3 ? atoi(argv[3]) : 100000;
+  gchar* const path = g_build_filename(dir, "startup_bench.db", NULL);
+  double* const old_times = g_new(double, runs);
+  double* const new_times = g_new(double, runs);
+  double* const migration_times = g_new(double, runs);
+
+  for (gint upgrade = 0; upgrade <= 1; upgrade++) {
+    for (gint n = 0; n < runs; n++) {
+      seed(path, upgrade, rows);
+      old_times[n] = before(path);
+      seed(path, upgrade, rows);
+      new_times[n] = after(path, &migration_times[n]);
+    }
+    printf("%s: before %.1f ms, after %.1f ms, then migrated on a thread in %.1f ms\n",
+        upgrade ? "upgrade" : "new", median(old_times, runs), median(new_times, runs),
+        median(migration_times, runs));
+  }
+
+  seed(path, FALSE, 0);
+  g_free(old_times);
+  g_free(new_times);
+  g_free(migration_times);
+  g_free(path);
+  return 0;
+}
+
+// vim:set et sw=2 ts=2 ai:
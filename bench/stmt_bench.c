@@ -0,0 +1,159 @@
+/* Copyright 2011 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Notifications per second through the SQLite helpers, formatting and
+// preparing every statement as gol used to against stmt_cache.c. Each
+// notification does what NOTIFY does: a history insert, the application
+// lookup and two config reads.
+//
+//   make stmt_bench
+//   ./stmt_bench [path|:memory:] [notifications] [nosync]
+//
+// The file at `path` is replaced.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "stmt_cache.h"
+
+static sqlite3* db;
+static STMT_CACHE* cache;
+
+static void
+format_exec(const char tsql[], ...) {
+  va_list list;
+  va_start(list, tsql);
+  char* const sql = sqlite3_vmprintf(tsql, list);
+  va_end(list);
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare(db, sql, strlen(sql), &stmt, NULL) == SQLITE_OK) {
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
+  sqlite3_free(sql);
+}
+
+static gint
+format_query_int(const char tsql[], ...) {
+  va_list list;
+  va_start(list, tsql);
+  char* const sql = sqlite3_vmprintf(tsql, list);
+  va_end(list);
+  sqlite3_stmt* stmt;
+  gint value = 0;
+  if (sqlite3_prepare(db, sql, strlen(sql), &stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_step(stmt) == SQLITE_ROW) value = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+  }
+  sqlite3_free(sql);
+  return value;
+}
+
+static void
+cached_exec(const char tsql[], ...) {
+  va_list list;
+  va_start(list, tsql);
+  sqlite3_stmt* const stmt = stmt_cache_acquire(cache, tsql, list);
+  va_end(list);
+  if (stmt) {
+    sqlite3_step(stmt);
+    stmt_cache_release(cache, tsql, stmt);
+  }
+}
+
+static gint
+cached_query_int(const char tsql[], ...) {
+  va_list list;
+  va_start(list, tsql);
+  sqlite3_stmt* const stmt = stmt_cache_acquire(cache, tsql, list);
+  va_end(list);
+  gint value = 0;
+  if (stmt) {
+    if (sqlite3_step(stmt) == SQLITE_ROW) value = sqlite3_column_int(stmt, 0);
+    stmt_cache_release(cache, tsql, stmt);
+  }
+  return value;
+}
+
+static double
+run(void(* exec)(const char[], ...), gint(* query_int)(const char[], ...),
+    const gint count, const gboolean insert) {
+  const gint64 started = g_get_monotonic_time();
+  for (gint n = 0; n < count; n++) {
+    gchar title[64];
+    g_snprintf(title, sizeof(title), "Build %d finished", n);
+    if (insert)
+      exec("insert into notification(title, text, icon, url, received)"
+          " values('%q', '%q', '%q', '%q', '%q')",
+          title, "All 1234 tests passed on branch master", "", "", "2011-01-01 00:00:00");
+    query_int("select enable from application where app_name = '%q' and name = '%q'",
+        "Build Bot", "Finished");
+    query_int("select value from config where key = '%q'", "default_display");
+    query_int("select value from config where key = '%q'", "default_timeout");
+  }
+  return count / ((g_get_monotonic_time() - started) / 1000000.0);
+}
+
+int
+main(int argc, char* argv[]) {
+  const char* const path = argc > 1 ? argv[1] : ":memory:";
+  const gint count = argc > 2 ? atoi(argv[2]) : 200000;
+  const gboolean nosync = argc > 3 && !strcmp(argv[3], "nosync");
+
+  if (strcmp(path, ":memory:")) remove(path);
+  if (sqlite3_open(path, &db) != SQLITE_OK) {
+    fprintf(stderr, "Can't open database: %s\n", path);
+    return 1;
+  }
+  if (nosync) sqlite3_exec(db, "pragma synchronous=off", NULL, NULL, NULL);
+  sqlite3_exec(db,
+      "create table config(key text not null primary key, value text not null);"
+      "create table notification(title text not null, text text not null,"
+      " icon text, url text, received timestamp not null);"
+      "create table application(app_name text not null, app_icon text not null,"
+      " name text not null, icon text not null, enable int not null,"
+      " display text not null, sticky int not null, primary key(app_name, name));"
+      "insert into config values('default_display', 'Fog');"
+      "insert into config values('default_timeout', '5000');"
+      "insert into application values('Build Bot', '', 'Finished', '', 1, 'Fog', 0);",
+      NULL, NULL, NULL);
+  cache = stmt_cache_new(db);
+
+  for (gint insert = 0; insert <= 1; insert++) {
+    const double before = run(format_exec, format_query_int, count, insert);
+    const double after = run(cached_exec, cached_query_int, count, insert);
+    printf("%s, %s: before %.0f/s, after %.0f/s (%.1fx)\n",
+        path, insert ? "with insert" : "lookups only", before, after, after / before);
+  }
+
+  stmt_cache_free(cache);
+  sqlite3_close(db);
+  return 0;
+}
+
+// vim:set et sw=2 ts=2 ai:
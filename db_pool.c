@@ -0,0 +1,120 @@
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "gol.h"
+#include "db_pool.h"
+
+struct _DB_POOL {
+  GPtrArray* readers;  // every DB_READER, for stats and cleanup
+  GAsyncQueue* idle;   // the ones not leased
+  gchar* path;
+  db_pool_setup_t setup;
+  gint leases;
+  gint waits;
+};
+
+static DB_READER*
+open_reader(DB_POOL* const pool, const gchar* const path, const db_pool_setup_t setup) {
+  sqlite3* db = NULL;
+  // Each connection is used by one thread at a time, so SQLite's own
+  // per-connection mutex is not needed.
+  if (sqlite3_open_v2(path, &db,
+        SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+    sqlite3_close(db);
+    return NULL;
+  }
+  // Readers only wait while a checkpoint or recovery holds the WAL index.
+  sqlite3_busy_timeout(db, 5000);
+  if (setup) setup(db);
+
+  DB_READER* const reader = g_new0(DB_READER, 1);
+  reader->pool = pool;
+  reader->db = db;
+  reader->cache = stmt_cache_new(db);
+  return reader;
+}
+
+static void
+close_reader(gpointer data) {
+  DB_READER* const reader = (DB_READER*) data;
+  stmt_cache_free(reader->cache);
+  sqlite3_close(reader->db);
+  g_free(reader);
+}
+
+DB_POOL*
+db_pool_new(const gchar* const path, const gint size, const db_pool_setup_t setup) {
+  DB_POOL* const pool = g_new0(DB_POOL, 1);
+  pool->readers = g_ptr_array_new_with_free_func(close_reader);
+  pool->idle = g_async_queue_new();
+  pool->path = g_strdup(path);
+  pool->setup = setup;
+
+  for (gint n = 0; n < size; ++n) {
+    DB_READER* const reader = open_reader(pool, path, setup);
+    if (!reader) break;
+    g_ptr_array_add(pool->readers, reader);
+    g_async_queue_push(pool->idle, reader);
+  }
+
+  if (!pool->readers->len) {
+    db_pool_free(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+void
+db_pool_free(DB_POOL* const pool) {
+  if (!pool) return;
+  g_async_queue_unref(pool->idle);
+  g_ptr_array_free(pool->readers, TRUE);
+  g_free(pool->path);
+  g_free(pool);
+}
+
+DB_READER*
+db_pool_acquire(DB_POOL* const pool) {
+  g_atomic_int_inc(&pool->leases);
+  DB_READER* reader = (DB_READER*) g_async_queue_try_pop(pool->idle);
+  if (!reader) {
+    g_atomic_int_inc(&pool->waits);
+    reader = (DB_READER*) g_async_queue_pop(pool->idle);
+  }
+  return reader;
+}
+
+void
+db_pool_release(DB_READER* const reader) {
+  if (reader) g_async_queue_push(reader->pool->idle, reader);
+}
+
+DB_READER*
+db_pool_open_dedicated(DB_POOL* const pool) {
+  return open_reader(pool, pool->path, pool->setup);
+}
+
+void
+db_pool_close_dedicated(DB_READER* const reader) {
+  if (reader) close_reader(reader);
+}
+
+void
+db_pool_stats(DB_POOL* const pool, guint* const size, guint* const leases, guint* const waits,
+    guint* const hits, guint* const prepares) {
+  *size = *leases = *waits = *hits = *prepares = 0;
+  if (!pool) return;
+  *size = pool->readers->len;
+  *leases = (guint) g_atomic_int_get(&pool->leases);
+  *waits = (guint) g_atomic_int_get(&pool->waits);
+  for (guint n = 0; n < pool->readers->len; ++n) {
+    guint reader_hits, reader_prepares;
+    stmt_cache_stats(((DB_READER*) g_ptr_array_index(pool->readers, n))->cache,
+        &reader_hits, &reader_prepares);
+    *hits += reader_hits;
+    *prepares += reader_prepares;
+  }
+}
+
+// vim:set et sw=2 ts=2 ai:
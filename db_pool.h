@@ -0,0 +1,60 @@
+#ifndef db_pool_h_
+#define db_pool_h_
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "stmt_cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _DB_POOL DB_POOL;
+
+// Run on each connection as it is opened, e.g. to register functions.
+typedef gboolean (*db_pool_setup_t)(sqlite3* db);
+
+// A read-only connection with statements of its own. Only the thread that
+// leased it may use it, until it is given back.
+typedef struct {
+  DB_POOL* pool;
+  sqlite3* db;
+  STMT_CACHE* cache;
+} DB_READER;
+
+// Opens `size` read-only connections to `path`. The database should be in
+// WAL mode, so readers neither wait for the writer nor hold it up.
+// Returns NULL if none could be opened. `setup` may be NULL.
+DB_POOL*
+db_pool_new(const gchar* path, gint size, db_pool_setup_t setup);
+
+// Every reader must have been released.
+void
+db_pool_free(DB_POOL* pool);
+
+// Waits for a free connection.
+DB_READER*
+db_pool_acquire(DB_POOL* pool);
+
+void
+db_pool_release(DB_READER* reader);
+
+// A connection of its own, opened like the pooled ones, for a reader kept
+// for a long time (a tree model), which would otherwise starve the pool.
+// Returns NULL if it can't be opened.
+DB_READER*
+db_pool_open_dedicated(DB_POOL* pool);
+
+void
+db_pool_close_dedicated(DB_READER* reader);
+
+void
+db_pool_stats(DB_POOL* pool, guint* size, guint* leases, guint* waits,
+    guint* hits, guint* prepares);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* db_pool_h_ */
@@ -0,0 +1,92 @@
+#include <glib.h>
+
+#include "gol.h"
+#include "dedupe.h"
+
+// Linear probing never looks further than this; beyond it we evict rather
+// than let a hot table degrade into a scan.
+#define DEDUPE_MAX_PROBE 16
+
+struct _DEDUPE_TABLE {
+  DEDUPE_ENTRY* entries;
+  guint64 mask;
+  gint64 ttl; // usec
+  guint evicted;
+};
+
+DEDUPE_TABLE*
+dedupe_new(const guint slots, const gint ttl) {
+  guint size = DEDUPE_MAX_PROBE;
+  while (size < slots && size < (1u << 30)) size <<= 1;
+
+  DEDUPE_TABLE* const dt = g_new0(DEDUPE_TABLE, 1);
+  dt->entries = g_new0(DEDUPE_ENTRY, size);
+  dt->mask = size - 1;
+  dt->ttl = (gint64) ttl * 1000;
+  return dt;
+}
+
+void
+dedupe_free(DEDUPE_TABLE* const dt) {
+  if (!dt) return;
+  g_free(dt->entries);
+  g_free(dt);
+}
+
+// 0 marks never-used slots, so fold it onto another value.
+static guint64
+dedupe_key(const guint64 hash) {
+  return hash ? hash : 1;
+}
+
+DEDUPE_ENTRY*
+dedupe_lookup(DEDUPE_TABLE* const dt, guint64 hash, const gint64 now, gboolean* const duplicate) {
+  hash = dedupe_key(hash);
+
+  DEDUPE_ENTRY* vacant = NULL;
+  DEDUPE_ENTRY* oldest = NULL;
+  for (guint probe = 0; probe < DEDUPE_MAX_PROBE; ++probe) {
+    DEDUPE_ENTRY* const e = &dt->entries[(hash + probe) & dt->mask];
+    if (e->hash == hash && e->expires > now) {
+      e->count++;
+      *duplicate = TRUE;
+      return e;
+    }
+    if (!e->hash || e->expires <= now) {
+      if (!vacant) vacant = e;
+      // Nothing was ever stored past a never-used slot.
+      if (!e->hash) break;
+      continue;
+    }
+    if (!oldest || e->expires < oldest->expires) oldest = e;
+  }
+
+  if (!vacant) {
+    vacant = oldest;
+    dt->evicted++;
+  }
+  vacant->hash = hash;
+  vacant->expires = now + dt->ttl;
+  vacant->count = 1;
+  vacant->data = NULL;
+  *duplicate = FALSE;
+  return vacant;
+}
+
+DEDUPE_ENTRY*
+dedupe_find(DEDUPE_TABLE* const dt, guint64 hash, const gint64 now) {
+  hash = dedupe_key(hash);
+  for (guint probe = 0; probe < DEDUPE_MAX_PROBE; ++probe) {
+    DEDUPE_ENTRY* const e = &dt->entries[(hash + probe) & dt->mask];
+    if (e->hash == hash && e->expires > now) return e;
+    if (!e->hash) break;
+  }
+  return NULL;
+}
+
+guint
+dedupe_evicted(const DEDUPE_TABLE* const dt) {
+  return dt->evicted;
+}
+
+// vim:set et sw=2 ts=2 ai:
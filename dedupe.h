@@ -0,0 +1,43 @@
+#ifndef dedupe_h_
+#define dedupe_h_
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  guint64 hash;   // 0: never used
+  gint64 expires; // monotonic usec
+  guint count;
+  gpointer data;  // owned by the caller
+} DEDUPE_ENTRY;
+
+typedef struct _DEDUPE_TABLE DEDUPE_TABLE;
+
+// `slots` is rounded up to a power of two; `ttl` is in milliseconds.
+DEDUPE_TABLE*
+dedupe_new(guint slots, gint ttl);
+
+void
+dedupe_free(DEDUPE_TABLE* dt);
+
+// Returns the live entry for `hash` with its count bumped and sets
+// *duplicate, or claims a fresh entry (count 1, data NULL). When the probe
+// window is full, the entry closest to expiry is evicted.
+DEDUPE_ENTRY*
+dedupe_lookup(DEDUPE_TABLE* dt, guint64 hash, gint64 now, gboolean* duplicate);
+
+// Live entry for `hash`, or NULL. Does not touch the count.
+DEDUPE_ENTRY*
+dedupe_find(DEDUPE_TABLE* dt, guint64 hash, gint64 now);
+
+guint
+dedupe_evicted(const DEDUPE_TABLE* dt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* dedupe_h_ */
@@ -0,0 +1,167 @@
+/* Copyright 2011 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+
+#include <glib.h>
+
+#include "gol.h"
+#include "dispatch.h"
+
+typedef struct _DISPATCH_TASK DISPATCH_TASK;
+struct _DISPATCH_TASK {
+  DISPATCH_TASK* next;
+  dispatch_func_t func;
+  gpointer data;
+  GDestroyNotify destroy;
+};
+
+typedef struct {
+  GSource source;
+  gint64 budget; // usec
+} DISPATCH_SOURCE;
+
+// Producers push onto this stack with CAS. The consumer always takes the
+// whole stack at once, so there is no ABA problem to worry about.
+static gpointer incoming;
+
+// Consumer side FIFO; only touched on the main loop.
+static DISPATCH_TASK* pending_head;
+static DISPATCH_TASK* pending_tail;
+
+static GSource* source;
+
+static gboolean
+has_tasks() {
+  return pending_head || g_atomic_pointer_get(&incoming);
+}
+
+static void
+take_incoming() {
+  DISPATCH_TASK* stack;
+  do {
+    stack = (DISPATCH_TASK*) g_atomic_pointer_get(&incoming);
+  } while (stack && !g_atomic_pointer_compare_and_exchange(&incoming, stack, NULL));
+  if (!stack) return;
+
+  // Stack is newest first; reverse into arrival order.
+  DISPATCH_TASK* const last = stack;
+  DISPATCH_TASK* fifo = NULL;
+  while (stack) {
+    DISPATCH_TASK* const next = stack->next;
+    stack->next = fifo;
+    fifo = stack;
+    stack = next;
+  }
+
+  if (pending_tail) pending_tail->next = fifo;
+  else pending_head = fifo;
+  pending_tail = last;
+}
+
+static gboolean
+dispatch_prepare(GSource* GOL_UNUSED_ARG(s), gint* timeout) {
+  *timeout = -1;
+  return has_tasks();
+}
+
+static gboolean
+dispatch_check(GSource* GOL_UNUSED_ARG(s)) {
+  return has_tasks();
+}
+
+static gboolean
+dispatch_dispatch(GSource* s, GSourceFunc GOL_UNUSED_ARG(callback), gpointer GOL_UNUSED_ARG(user_data)) {
+  const gint64 deadline = g_get_monotonic_time() + ((DISPATCH_SOURCE*) s)->budget;
+
+  take_incoming();
+  while (pending_head) {
+    DISPATCH_TASK* const task = pending_head;
+    if (!(pending_head = task->next)) pending_tail = NULL;
+
+    task->func(task->data);
+    g_free(task);
+
+    // Leftovers make prepare() return TRUE, so we come back right after
+    // GTK had a chance to handle its own events.
+    if (g_get_monotonic_time() >= deadline) break;
+  }
+  return TRUE;
+}
+
+static GSourceFuncs dispatch_funcs = {
+  dispatch_prepare,
+  dispatch_check,
+  dispatch_dispatch,
+  NULL,
+};
+
+gboolean
+dispatch_init(const gint budget) {
+  if (source) return TRUE;
+
+  source = g_source_new(&dispatch_funcs, sizeof(DISPATCH_SOURCE));
+  if (!source) return FALSE;
+  ((DISPATCH_SOURCE*) source)->budget = (gint64) budget * 1000;
+  g_source_set_priority(source, G_PRIORITY_DEFAULT_IDLE);
+  g_source_attach(source, NULL);
+  return TRUE;
+}
+
+void
+dispatch_term() {
+  if (!source) return;
+  g_source_destroy(source);
+  g_source_unref(source);
+  source = NULL;
+
+  // Whatever the tasks would have shown is gone by now; only free them.
+  take_incoming();
+  while (pending_head) {
+    DISPATCH_TASK* const task = pending_head;
+    pending_head = task->next;
+    if (task->destroy) task->destroy(task->data);
+    g_free(task);
+  }
+  pending_tail = NULL;
+}
+
+void
+dispatch_push(const dispatch_func_t func, const gpointer data, const GDestroyNotify destroy) {
+  DISPATCH_TASK* const task = g_new(DISPATCH_TASK, 1);
+  task->func = func;
+  task->data = data;
+  task->destroy = destroy;
+
+  gpointer top;
+  do {
+    top = g_atomic_pointer_get(&incoming);
+    task->next = (DISPATCH_TASK*) top;
+  } while (!g_atomic_pointer_compare_and_exchange(&incoming, top, task));
+
+  // Only the push that makes the queue non-empty needs to wake the loop;
+  // later pushes are picked up by the same drain.
+  if (!top) g_main_context_wakeup(NULL);
+}
+
+// vim:set et sw=2 ts=2 ai:
@@ -0,0 +1,30 @@
+#ifndef dispatch_h_
+#define dispatch_h_
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*dispatch_func_t)(gpointer);
+
+// Attach the drain source to the default main context. Each iteration runs
+// queued tasks until `budget` milliseconds have elapsed, then yields to GTK.
+gboolean
+dispatch_init(gint budget);
+
+void
+dispatch_term();
+
+// Queue `func(data)` to run on the main loop. Safe to call from any thread.
+// If dispatch_term() comes first, `data` is passed to `destroy` instead;
+// `destroy` may be NULL.
+void
+dispatch_push(dispatch_func_t func, gpointer data, GDestroyNotify destroy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* dispatch_h_ */
@@ -29,10 +29,10 @@
 
 #include "gol.h"
 #include "compatibility.h"
-#include "plugins/from_url.h"
 
 #include "display_fog.xpm"
 
+static DISPLAY_CONTEXT* dc;
 static GList* notifications;
 static GList* popup_collections;
 
@@ -116,6 +116,7 @@ display_animation_func(gpointer data) {
   if (di->timeout < 0) {
     notifications = g_list_remove(notifications, di);
     popup_collections = g_list_append(popup_collections, di);
+    dc->closed(di->ni);
     reset_display_info(di, NULL);
     return FALSE;
   }
@@ -190,20 +191,16 @@ box_set_icon_if_has(const DISPLAY_INFO* const di) {
   const NOTIFICATION_INFO* const ni = di->ni;
   if (!ni->icon || !*ni->icon) return;
 
-  GdkPixbuf* const pixbuf =
-    (ni->local ? pixbuf_from_url_as_file
-               : pixbuf_from_url)(ni->icon, NULL);
+  GdkPixbuf* const pixbuf = dc->icon(ni->icon, ni->local, 32);
   if (!pixbuf) return;
 
-  GdkPixbuf* const tmp = gdk_pixbuf_scale_simple(pixbuf, 32, 32, GDK_INTERP_TILES);
-  GtkWidget* const image = gtk_image_new_from_pixbuf(tmp ? tmp : pixbuf);
+  GtkWidget* const image = gtk_image_new_from_pixbuf(pixbuf);
   if (image) {
     GtkBox* const hbox = DISPLAY_HBOX(di);
     gtk_box_pack_start(hbox, image, FALSE, FALSE, 0);
     gtk_box_reorder_child(hbox, DISPLAY_HBOX_NTH_ELEM(di, 0), 1);
   }
 
-  if (tmp) g_object_unref(tmp);
   g_object_unref(pixbuf);
 }
 
@@ -314,6 +311,14 @@ reset_display_info(DISPLAY_INFO* const di, NOTIFICATION_INFO* const ni) {
   return di;
 }
 
+static inline void
+set_display_labels(const DISPLAY_INFO* const di) {
+  gchar* const title = notification_info_title(di->ni);
+  gtk_label_set_text(DISPLAY_TITLE_FIELD(di), title);
+  gtk_label_set_text(DISPLAY_TEXT_FIELD(di), di->ni->text);
+  g_free(title);
+}
+
 static inline gpointer
 list_pop_front(GList** list) {
   if (!list) return NULL;
@@ -337,7 +342,11 @@ get_popup_skelton(NOTIFICATION_INFO* const ni) {
 G_MODULE_EXPORT gboolean
 display_show(NOTIFICATION_INFO* const ni) {
   DISPLAY_INFO* const di = get_popup_skelton(ni);
-  if (!di) return FALSE;
+  if (!di) {
+    dc->closed(ni);
+    free_notification_info(ni);
+    return FALSE;
+  }
 
   gint
   is_differ_pos(gconstpointer p, gconstpointer GOL_UNUSED_ARG(user_data)) {
@@ -352,14 +361,14 @@ display_show(NOTIFICATION_INFO* const ni) {
   di->x = screen_rect.x + screen_rect.width  - cx * 200 - 180;
   di->y = screen_rect.y + screen_rect.height - cy * 180 + 20;
   if (di->x < 0) {
+    dc->closed(di->ni);
     free_display_info(di);
     return FALSE;
   }
   notifications = g_list_insert_before(notifications, found, di);
 
   box_set_icon_if_has(di);
-  gtk_label_set_text(DISPLAY_TITLE_FIELD(di), di->ni->title);
-  gtk_label_set_text(DISPLAY_TEXT_FIELD(di), di->ni->text);
+  set_display_labels(di);
 
   gtk_window_move(GTK_WINDOW(di->widget.popup), di->x, di->y);
   gtk_widget_show_all(di->widget.popup);
@@ -368,8 +377,53 @@ display_show(NOTIFICATION_INFO* const ni) {
   return FALSE;
 }
 
+static DISPLAY_INFO*
+find_display_info(const NOTIFICATION_INFO* const ni) {
+  gint
+  is_differ_ni(gconstpointer p, gconstpointer GOL_UNUSED_ARG(user_data)) {
+    return ((const DISPLAY_INFO*) p)->ni != ni;
+  }
+  GList* const found = g_list_find_custom(notifications, NULL, is_differ_ni);
+  return found ? (DISPLAY_INFO*) found->data : NULL;
+}
+
+G_MODULE_EXPORT gboolean
+display_expire(NOTIFICATION_INFO* const ni) {
+  DISPLAY_INFO* const di = find_display_info(ni);
+  if (!di) return FALSE;
+
+  if (di->timeout >= 30) di->timeout = 30;
+  di->ni->sticky = FALSE;
+  return TRUE;
+}
+
+G_MODULE_EXPORT gboolean
+display_refresh(NOTIFICATION_INFO* const ni) {
+  DISPLAY_INFO* const di = find_display_info(ni);
+  if (!di) return FALSE;
+
+  remove_icon(di);
+  box_set_icon_if_has(di);
+  set_display_labels(di);
+  gtk_widget_show_all(di->widget.popup);
+
+  // Start over, even if it was already fading out.
+  di->default_timeout = ni->timeout;
+  di->timeout = ni->timeout;
+  gtk_window_set_opacity(GTK_WINDOW(di->widget.popup), 0.8);
+  return TRUE;
+}
+
+G_MODULE_EXPORT gint
+display_capacity() {
+  const gint vert_count = screen_rect.height / 180;
+  const gint horz_count = (screen_rect.x + screen_rect.width - 180) / 200 + 1;
+  return MAX(vert_count, 1) * MAX(horz_count, 1);
+}
+
 G_MODULE_EXPORT gboolean
-display_init() {
+display_init(DISPLAY_CONTEXT* const _dc) {
+  dc = _dc;
   gdk_color_parse("lightgray", &inst_color_lightgray_);
   gdk_color_parse("black", &inst_color_black_);
 
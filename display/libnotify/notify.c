@@ -29,20 +29,40 @@
 #include <libnotify/notify.h>
 
 #include "gol.h"
-#include "plugins/from_url.h"
 
 #include "display_libnotify.xpm"
 
+static DISPLAY_CONTEXT* dc;
+static GHashTable* notifications; // NOTIFICATION_INFO* -> NotifyNotification*
+
 G_MODULE_EXPORT gboolean
-display_init() {
+display_init(DISPLAY_CONTEXT* const _dc) {
+  dc = _dc;
+  notifications = g_hash_table_new(g_direct_hash, g_direct_equal);
   return notify_init("Growl for Linux");
 }
 
 G_MODULE_EXPORT void
 display_term() {
+  void
+  free_notification(gpointer key, gpointer value, gpointer GOL_UNUSED_ARG(user_data)) {
+    free_notification_info((NOTIFICATION_INFO*) key);
+    g_object_unref(value);
+  }
+  g_hash_table_foreach(notifications, free_notification, NULL);
+  g_hash_table_destroy(notifications);
   notify_uninit();
 }
 
+static void
+notification_closed(NotifyNotification* const nt, const gpointer user_data) {
+  NOTIFICATION_INFO* const ni = (NOTIFICATION_INFO*) user_data;
+  g_hash_table_remove(notifications, ni);
+  dc->closed(ni);
+  free_notification_info(ni);
+  g_object_unref(nt);
+}
+
 static gchar*
 get_icon_path_if_local(const NOTIFICATION_INFO* ni) {
   if (!ni->local || !ni->icon) return NULL;
@@ -52,42 +72,80 @@ get_icon_path_if_local(const NOTIFICATION_INFO* ni) {
 }
 
 G_MODULE_EXPORT gboolean
-display_show(gpointer data) {
-  const NOTIFICATION_INFO* const ni = (const NOTIFICATION_INFO*) data;
+display_show(NOTIFICATION_INFO* const ni) {
 
   gchar* const icon_path = get_icon_path_if_local(ni);
+  gchar* const title = notification_info_title(ni);
   gchar* const text = g_markup_escape_text(ni->text, -1);
 #ifdef NOTIFY_CHECK_VERSION
 # if NOTIFY_CHECK_VERSION (0, 7, 0)
-  NotifyNotification* const nt = notify_notification_new(ni->title, text, icon_path);
+  NotifyNotification* const nt = notify_notification_new(title, text, icon_path);
 # else
-  NotifyNotification* const nt = notify_notification_new(ni->title, text, icon_path, NULL);
+  NotifyNotification* const nt = notify_notification_new(title, text, icon_path, NULL);
 # endif
 #else
-  NotifyNotification* const nt = notify_notification_new(ni->title, text, icon_path, NULL);
+  NotifyNotification* const nt = notify_notification_new(title, text, icon_path, NULL);
 #endif
   g_free(icon_path);
+  g_free(title);
   g_free(text);
 
-  GdkPixbuf* const pixbuf = !ni->local ? pixbuf_from_url(ni->icon, NULL) : NULL;
+  GdkPixbuf* const pixbuf = !ni->local ? dc->icon(ni->icon, FALSE, 0) : NULL;
   if (pixbuf) {
     notify_notification_set_icon_from_pixbuf(nt, pixbuf);
     g_object_unref(pixbuf);
   }
 
-  if (ni->sticky)
+  if (ni->sticky || ni->priority >= 2)
     notify_notification_set_urgency(nt, NOTIFY_URGENCY_CRITICAL);
+  else if (ni->priority < 0)
+    notify_notification_set_urgency(nt, NOTIFY_URGENCY_LOW);
+
+  g_signal_connect(G_OBJECT(nt), "closed", G_CALLBACK(notification_closed), ni);
+  g_hash_table_insert(notifications, ni, nt);
 
   GError* error = NULL;
   if (!notify_notification_show(nt, &error))
   {
       g_warning("%s: %s", G_STRFUNC, error->message);
       g_error_free(error);
+      notification_closed(nt, ni);
   }
 
   return FALSE;
 }
 
+G_MODULE_EXPORT gboolean
+display_expire(NOTIFICATION_INFO* const ni) {
+  NotifyNotification* const nt =
+    (NotifyNotification*) g_hash_table_lookup(notifications, ni);
+  return nt && notify_notification_close(nt, NULL);
+}
+
+// Same notification id, so the server replaces the bubble in place.
+G_MODULE_EXPORT gboolean
+display_refresh(NOTIFICATION_INFO* const ni) {
+  NotifyNotification* const nt =
+    (NotifyNotification*) g_hash_table_lookup(notifications, ni);
+  if (!nt) return FALSE;
+
+  gchar* const icon_path = get_icon_path_if_local(ni);
+  gchar* const title = notification_info_title(ni);
+  gchar* const text = g_markup_escape_text(ni->text, -1);
+  notify_notification_update(nt, title, text, icon_path);
+  g_free(icon_path);
+  g_free(title);
+  g_free(text);
+
+  GError* error = NULL;
+  if (!notify_notification_show(nt, &error)) {
+    g_warning("%s: %s", G_STRFUNC, error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
 G_MODULE_EXPORT const gchar*
 display_name() {
   return "libnotify";
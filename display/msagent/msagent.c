@@ -47,6 +47,15 @@ static IID IID_IAgentEx = {0x48D12BA0,0x5B77,0x11d1,{0x9E,0xC1,0x00,0xC0,0x4F,0x
 static CLSID CLSID_AgentServer = {0xD45FD2FC,0x5C6E,0x11D1,{0x9E,0xC1,0x00,0xC0,0x4F,0xD7,0x08,0x1F}};
 static IDispatch* pAgentEx = NULL;
 static IDispatch* pCharacterEx = NULL;
+static DISPLAY_CONTEXT* dc;
+
+// The agent speaks asynchronously; nothing stays on screen for us to track.
+static gboolean
+display_done(NOTIFICATION_INFO* const ni) {
+  dc->closed(ni);
+  free_notification_info(ni);
+  return FALSE;
+}
 
 G_MODULE_EXPORT gboolean
 display_show(gpointer data) {
@@ -111,7 +120,7 @@ display_show(gpointer data) {
     hr = pAgentEx->lpVtbl->Invoke(pAgentEx, dispid, &IID_NULL, LOCALE_SYSTEM_DEFAULT, DISPATCH_METHOD,
         &param, &result, NULL, NULL);
 
-    if (!SUCCEEDED(hr)) return FALSE;
+    if (!SUCCEEDED(hr)) return display_done(ni);
   
     // SetPosition
     name = SysAllocString(L"SetPosition");
@@ -172,11 +181,12 @@ display_show(gpointer data) {
 
   g_free(speak_text);
 
-  return FALSE;
+  return display_done(ni);
 }
 
 G_MODULE_EXPORT gboolean
-display_init() {
+display_init(DISPLAY_CONTEXT* const _dc) {
+  dc = _dc;
   return TRUE;
 }
 
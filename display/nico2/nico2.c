@@ -30,12 +30,12 @@
 
 #include "gol.h"
 #include "compatibility.h"
-#include "plugins/from_url.h"
 
 #include "display_nico2.xpm"
 
 #define lengthof(arr_) (sizeof(arr_) / sizeof(*arr_))
 
+static DISPLAY_CONTEXT* dc;
 static GList* notifications;
 
 static const char* available_colors[] = { "red", "blue", "orange" };
@@ -108,6 +108,7 @@ display_animation_func(gpointer data) {
     gtk_widget_destroy(di->popup);
     di->popup = NULL;
     notifications = g_list_remove(notifications, di);
+    dc->closed(di->ni);
     free_display_info(di);
     return FALSE;
   }
@@ -123,6 +124,8 @@ display_show(NOTIFICATION_INFO* ni) {
   DISPLAY_INFO* di = g_new0(DISPLAY_INFO, 1);
   if (!di) {
     perror("g_new0");
+    dc->closed(ni);
+    free_notification_info(ni);
     return FALSE;
   }
   di->ni = ni;
@@ -149,22 +152,8 @@ display_show(NOTIFICATION_INFO* ni) {
 
   GtkWidget* image = NULL;
   if (di->ni->icon && *di->ni->icon) {
-    GdkPixbuf* pixbuf;
-    if (di->ni->local) {
-      gchar* newurl = g_filename_from_uri(di->ni->icon, NULL, NULL);
-      GError* error = NULL;
-      pixbuf = gdk_pixbuf_new_from_file(newurl ? newurl : di->ni->icon, &error);
-      g_free(newurl);
-    } else {
-      pixbuf = pixbuf_from_url(di->ni->icon, NULL);
-    }
-
+    GdkPixbuf* const pixbuf = dc->icon(di->ni->icon, di->ni->local, 32);
     if (pixbuf) {
-      GdkPixbuf* tmp = gdk_pixbuf_scale_simple(pixbuf, 32, 32, GDK_INTERP_TILES);
-      if (tmp) {
-        g_object_unref(pixbuf);
-        pixbuf = tmp;
-      }
       image = gtk_image_new_from_pixbuf(pixbuf);
       gtk_container_add(GTK_CONTAINER(fixed), image);
       g_object_unref(pixbuf);
@@ -224,7 +213,8 @@ display_show(NOTIFICATION_INFO* ni) {
 }
 
 G_MODULE_EXPORT gboolean
-display_init() {
+display_init(DISPLAY_CONTEXT* const _dc) {
+  dc = _dc;
   for (size_t cnt = lengthof(available_colors); cnt--;)
     gdk_color_parse(available_colors[ cnt ], inst_colors_ + cnt);
   gdk_color_parse("black", &inst_color_black_);
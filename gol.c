@@ -33,6 +33,7 @@
 #include <string.h>
 #include <getopt.h>
 #include <errno.h>
+#include <time.h>
 
 #include <gtk/gtk.h>
 #ifdef _WIN32
@@ -56,6 +57,19 @@
 
 #include "gol.h"
 #include "compatibility.h"
+#include "dispatch.h"
+#include "dedupe.h"
+#include "rules.h"
+#include "stmt_cache.h"
+#include "db_pool.h"
+#include "history.h"
+#include "history_model.h"
+#include "history_log.h"
+#include "history_export.h"
+#include "history_codec.h"
+#include "rollup.h"
+#include "recent.h"
+#include "icon_cache.h"
 
 #ifdef HAVE_APP_INDICATOR
 #include <libappindicator/app-indicator.h>
@@ -82,9 +96,13 @@ typedef struct {
   gchar* (*get_param)();
 } SUBSCRIBE_PLUGIN;
 
+#define PRIORITY_MIN    (-2)
+#define PRIORITY_MAX    (2)
+#define PRIORITY_LEVELS (PRIORITY_MAX - PRIORITY_MIN + 1)
+
 typedef struct {
   void* handle;
-  gboolean (*init)();
+  gboolean (*init)(DISPLAY_CONTEXT*);
   gboolean (*show)(NOTIFICATION_INFO* ni);
   gboolean (*term)();
   const gchar* (*name)();
@@ -92,6 +110,14 @@ typedef struct {
   gchar** (*thumbnail)();
   void (*set_param)(const gchar*);
   gchar* (*get_param)();
+  gboolean (*expire)(NOTIFICATION_INFO* ni);
+  gint (*capacity)();
+  gboolean (*refresh)(NOTIFICATION_INFO* ni);
+
+  GList* visible;
+  GQueue waiting[PRIORITY_LEVELS];
+  gboolean pumping;
+  guint dropped;
 } DISPLAY_PLUGIN;
 
 typedef enum
@@ -104,6 +130,26 @@ static gchar* password;
 static gboolean require_password_for_local_apps = FALSE;
 static gboolean require_password_for_lan_apps = FALSE;
 static sqlite3 *db;
+static STMT_CACHE* stmt_cache;
+// Read-only connections for queries; `db` is the only one that writes.
+static DB_POOL* readers;
+// Where history is kept when it goes to the log rather than the database.
+static gchar* history_log_dir;
+// The last notifications received, for the tray menu and the history tab
+// without a query. Main loop only.
+static RECENT_RING* recent;
+static gint recent_size;
+// Progress of the schema migration, for the statistics tab.
+static gint migration_step;
+static gint migration_steps;
+static gint64 migration_usec;
+static GThread* migration_thread;
+
+// Monotonic times of the startup milestones, for the statistics tab.
+static gint64 startup_at;
+static gint64 listening_at;
+static gint64 first_request_at;
+
 #ifdef HAVE_APP_INDICATOR
 static AppIndicator* indicator;
 #else
@@ -112,6 +158,9 @@ static GtkStatusIcon* status_icon;
 static GdkPixbuf* status_icon_pixbuf, * status_icon_dnd_pixbuf;
 static status_t gol_status;
 static GtkWidget* popup_menu;
+// Submenu of popup_menu listing the newest entries of `recent`.
+static GtkWidget* recent_menu;
+static guint recent_menu_refresh;
 static GtkWidget* setting_dialog;
 static GtkWidget* about_dialog;
 static GList* display_plugins;
@@ -241,51 +290,81 @@ foreach_subscribe_plugin(void(* func)(SUBSCRIBE_PLUGIN*)) {
   g_list_foreach(subscribe_plugins, wrapped_func, NULL);
 }
 
-static void
+// Every write on the shared connection holds this, one statement at a
+// time or, through begin_sqlite3(), for a whole transaction, so statements
+// from other threads can't end up in someone else's transaction.
+#if GLIB_CHECK_VERSION(2, 32, 0)
+static GRecMutex writer; // statically allocated, so needs no init
+# define lock_writer() g_rec_mutex_lock(&writer)
+# define unlock_writer() g_rec_mutex_unlock(&writer)
+#else
+static GStaticRecMutex writer = G_STATIC_REC_MUTEX_INIT;
+# define lock_writer() g_static_rec_mutex_lock(&writer)
+# define unlock_writer() g_static_rec_mutex_unlock(&writer)
+#endif
+
+// Returns FALSE if the statement failed.
+static gboolean
 exec_sqlite3(const char tsql[], ...) {
   va_list list;
   va_start(list, tsql);
 
-  char* const sql = sqlite3_vmprintf(tsql, list);
-  gol_debug_message("request \n\t\"%s\"", sql);
-  if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK)
-    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
-  sqlite3_free(sql);
+  gol_debug_message("request \n\t\"%s\"", tsql);
+  gboolean ok = FALSE;
+  lock_writer();
+  sqlite3_stmt* const stmt = stmt_cache_acquire(stmt_cache, tsql, list);
+  if (stmt) {
+    const int rc = sqlite3_step(stmt);
+    ok = rc == SQLITE_DONE || rc == SQLITE_ROW;
+    if (!ok)
+      gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+    stmt_cache_release(stmt_cache, tsql, stmt);
+  }
+  unlock_writer();
 
   va_end(list);
+  return ok;
 }
 
-static sqlite3_stmt *
-vprepare_sqlite3(const char* const tsql, va_list list) {
-  char* const sql = sqlite3_vmprintf(tsql, list);
-  gol_debug_message("request \n\t\"%s\"", sql);
-  sqlite3_stmt* stmt = NULL;
-  if (sqlite3_prepare(db, sql, strlen(sql), &stmt, NULL) != SQLITE_OK)
-    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
-  sqlite3_free(sql);
-  return stmt;
+// Holds the writer lock until commit_sqlite3().
+static void
+begin_sqlite3() {
+  lock_writer();
+  exec_sqlite3("begin");
 }
 
-static sqlite3_stmt *
-prepare_sqlite3(const char* const tsql, ...) {
-  va_list list;
-  va_start(list, tsql);
-
-  sqlite3_stmt* const stmt = vprepare_sqlite3(tsql, list);
+static gboolean
+commit_sqlite3() {
+  const gboolean ok = exec_sqlite3("commit");
+  if (!ok) exec_sqlite3("rollback");
+  unlock_writer();
+  return ok;
+}
 
-  va_end(list);
-  return stmt;
+// Ends a transaction from begin_sqlite3() without keeping any of it.
+static void
+rollback_sqlite3() {
+  exec_sqlite3("rollback");
+  unlock_writer();
 }
 
+// For queries only. They run on a pooled read-only connection, so they
+// never wait behind a write; before the pool is up, on the writer.
+// stmt_func must copy out whatever it needs; the statement is reset after.
 static void
 statement_sqlite3(void(* stmt_func)(sqlite3_stmt*), const char* const tsql, ...) {
   va_list list;
   va_start(list, tsql);
 
-  sqlite3_stmt* const stmt = vprepare_sqlite3(tsql, list);
-  stmt_func(stmt);
-
-  sqlite3_finalize(stmt);
+  gol_debug_message("request \n\t\"%s\"", tsql);
+  DB_READER* const reader = readers ? db_pool_acquire(readers) : NULL;
+  STMT_CACHE* const cache = reader ? reader->cache : stmt_cache;
+  sqlite3_stmt* const stmt = stmt_cache_acquire(cache, tsql, list);
+  if (stmt) {
+    stmt_func(stmt);
+    stmt_cache_release(cache, tsql, stmt);
+  }
+  db_pool_release(reader);
 
   va_end(list);
 }
@@ -304,17 +383,50 @@ pixbuf_from_datadir(const gchar* filename, GError** error) {
   return pixbuf;
 }
 
-static gboolean
-get_config_bool(const char* key, gboolean def) {
-  gboolean ret;
+// Mirror of the config table, so lookups on the notification path never
+// touch SQLite. Filled once after the database is opened and kept current
+// by set_config_string(). I/O threads read it too; the lock is only held
+// for the lookup itself.
+static GHashTable* config_cache;
+G_LOCK_DEFINE_STATIC(config_cache);
+
+static void
+load_config_cache() {
+  GHashTable* const cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
   void
-  get_int(sqlite3_stmt* const stmt) {
-    ret = sqlite3_step(stmt) == SQLITE_ROW
-      ? (gboolean) sqlite3_column_int(stmt, 0)
-      : def;
+  fill_cache(sqlite3_stmt* const stmt) {
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+      g_hash_table_replace(cache,
+          g_strdup((const char*) sqlite3_column_text(stmt, 0)),
+          g_strdup((const char*) sqlite3_column_text(stmt, 1)));
   }
-  statement_sqlite3(get_int,
-      "select value from config where key = '%q'", key);
+  statement_sqlite3(fill_cache, "select key, value from config");
+
+  G_LOCK(config_cache);
+  config_cache = cache;
+  G_UNLOCK(config_cache);
+}
+
+static void
+unload_config_cache() {
+  G_LOCK(config_cache);
+  if (config_cache) g_hash_table_destroy(config_cache);
+  config_cache = NULL;
+  G_UNLOCK(config_cache);
+}
+
+// Caller holds the lock.
+static const gchar*
+lookup_config_cache(const char* const key) {
+  return config_cache ? (const gchar*) g_hash_table_lookup(config_cache, key) : NULL;
+}
+
+static gboolean
+get_config_bool(const char* key, gboolean def) {
+  G_LOCK(config_cache);
+  const gchar* const value = lookup_config_cache(key);
+  const gboolean ret = value ? g_ascii_strtoll(value, NULL, 10) != 0 : def;
+  G_UNLOCK(config_cache);
   return ret;
 }
 
@@ -350,45 +462,49 @@ get_display_parameter(const char* const name, const char* const def) {
 static void
 set_display_parameter(const char* const name, const char* const value) {
   gol_debug_message("name: %s, parameter: %s", name, value);
+  begin_sqlite3();
   exec_sqlite3("delete from display where name = '%q'", name);
-
   exec_sqlite3("insert into display(name, parameter) values('%q', '%q')", name, value);
+  commit_sqlite3();
 }
 
 static gint
 get_config_value(const char* const key, const gint def) {
-  gchar* data;
-  gint value;
-  void
-  get_string(sqlite3_stmt* const stmt) {
-    data = sqlite3_step(stmt) == SQLITE_ROW
-          ? (char*) sqlite3_column_text(stmt, 0): "";
-  }
-  statement_sqlite3(get_string,
-      "select value from config where key = '%q'", key);
-  value = g_ascii_strtoll(data, NULL, 10);
+  G_LOCK(config_cache);
+  const gchar* const data = lookup_config_cache(key);
+  const gint value = data ? g_ascii_strtoll(data, NULL, 10) : 0;
+  G_UNLOCK(config_cache);
   return value != 0 ? value : def;
 }
 
 static gchar*
 get_config_string(const char* const key, const char* const def) {
-  gchar* value;
-  void
-  get_string(sqlite3_stmt* const stmt) {
-    value = g_strdup(
-        sqlite3_step(stmt) == SQLITE_ROW
-          ? (char*) sqlite3_column_text(stmt, 0)
-          : def ? def : "");
-  }
-  statement_sqlite3(get_string,
-      "select value from config where key = '%q'", key);
+  G_LOCK(config_cache);
+  const gchar* const data = lookup_config_cache(key);
+  gchar* const value = g_strdup(data ? data : def ? def : "");
+  G_UNLOCK(config_cache);
   return value;
 }
 
+// For values already written by another connection.
+static void
+cache_config_string(const char* const key, const char* const value) {
+  G_LOCK(config_cache);
+  if (config_cache)
+    g_hash_table_replace(config_cache, g_strdup(key), g_strdup(value));
+  G_UNLOCK(config_cache);
+}
+
 static void
 set_config_string(const char* const key, const char* const value) {
-  exec_sqlite3("delete from config where key = '%q'", key);
-  exec_sqlite3("insert into config(key, value) values('%q', '%q')", key, value);
+  // The cache only ever shows what was saved.
+  begin_sqlite3();
+  if (exec_sqlite3("delete from config where key = '%q'", key)
+      && exec_sqlite3("insert into config(key, value) values('%q', '%q')", key, value)) {
+    if (commit_sqlite3()) cache_config_string(key, value);
+  } else {
+    rollback_sqlite3();
+  }
 }
 
 static void
@@ -396,6 +512,328 @@ set_config_bool(const char* key, gboolean value) {
   set_config_string(key, value ? "1" : "0");
 }
 
+typedef struct {
+  gchar* application_name;
+  gchar* notification_name;
+  gboolean enabled;
+  DISPLAY_PLUGIN* dp; // NULL if the registered display isn't loaded
+} ROUTE;
+
+// The application table as seen by NOTIFY: a set of ROUTEs keyed on the
+// application and notification names, with the display already resolved.
+// Filled after the display plugins are loaded and kept current by REGISTER
+// and the settings dialog.
+static GHashTable* routes;
+G_LOCK_DEFINE_STATIC(routes);
+
+static guint
+route_hash(gconstpointer data) {
+  const ROUTE* const route = (const ROUTE*) data;
+  return (guint) gol_hash64_string(
+      gol_hash64_string(GOL_HASH64_INIT, route->application_name), route->notification_name);
+}
+
+static gboolean
+route_equal(gconstpointer a, gconstpointer b) {
+  const ROUTE* const x = (const ROUTE*) a;
+  const ROUTE* const y = (const ROUTE*) b;
+  return !g_strcmp0(x->application_name, y->application_name)
+    && !g_strcmp0(x->notification_name, y->notification_name);
+}
+
+static void
+free_route(gpointer data) {
+  ROUTE* const route = (ROUTE*) data;
+  g_free(route->application_name);
+  g_free(route->notification_name);
+  g_free(route);
+}
+
+// Only for lookups; the names are not copied.
+static ROUTE
+route_key(const char* const application_name, const char* const notification_name) {
+  return (ROUTE){
+    .application_name  = (gchar*) application_name,
+    .notification_name = (gchar*) notification_name,
+  };
+}
+
+static DISPLAY_PLUGIN*
+find_display_plugin_by_name(const char* const name) {
+  bool
+  is_named(const DISPLAY_PLUGIN* dp) {
+    return !g_ascii_strcasecmp(dp->name(), name);
+  }
+  return name ? find_display_plugin(is_named) : NULL;
+}
+
+static ROUTE*
+route_new(const char* const application_name, const char* const notification_name,
+    const gboolean enabled, const char* const display) {
+  ROUTE* const route = g_new(ROUTE, 1);
+  route->application_name = g_strdup(application_name);
+  route->notification_name = g_strdup(notification_name);
+  route->enabled = enabled;
+  route->dp = find_display_plugin_by_name(display);
+  return route;
+}
+
+static ROUTE*
+route_from_row(sqlite3_stmt* const stmt) {
+  return route_new(
+      (const char*) sqlite3_column_text(stmt, 0),
+      (const char*) sqlite3_column_text(stmt, 1),
+      sqlite3_column_int(stmt, 2) != 0,
+      (const char*) sqlite3_column_text(stmt, 3));
+}
+
+// A route from a REGISTER that is not committed yet.
+typedef struct {
+  gchar* name;
+  gchar* display;
+  gboolean enabled;
+} NEW_ROUTE;
+
+// A notification that was registered before keeps its route, as its row
+// keeps the user's settings.
+static void
+add_route(const char* const application_name, const char* const notification_name,
+    const gboolean enabled, const char* const display) {
+  ROUTE* const route = route_new(application_name, notification_name, enabled, display);
+  G_LOCK(routes);
+  const gboolean added = routes && !g_hash_table_lookup(routes, route);
+  if (added) g_hash_table_replace(routes, route, route);
+  G_UNLOCK(routes);
+  if (!added) free_route(route);
+}
+
+// The table is read without the lock, which is only taken to swap it in,
+// so NOTIFY never waits on the query.
+static void
+load_routes() {
+  GHashTable* const table = g_hash_table_new_full(route_hash, route_equal, free_route, NULL);
+  void
+  fill_routes(sqlite3_stmt* const stmt) {
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      ROUTE* const route = route_from_row(stmt);
+      g_hash_table_replace(table, route, route);
+    }
+  }
+  statement_sqlite3(fill_routes,
+      "select app_name, name, enable, display from application");
+
+  G_LOCK(routes);
+  GHashTable* const old = routes;
+  routes = table;
+  G_UNLOCK(routes);
+  if (old) g_hash_table_destroy(old);
+}
+
+// Re-reads one row after it was changed in the application table.
+static void
+reload_route(const char* const application_name, const char* const notification_name) {
+  ROUTE* route = NULL;
+  void
+  refill_route(sqlite3_stmt* const stmt) {
+    if (sqlite3_step(stmt) == SQLITE_ROW) route = route_from_row(stmt);
+  }
+  statement_sqlite3(refill_route,
+      "select app_name, name, enable, display from application"
+      " where app_name = '%q' and name = '%q'",
+      application_name, notification_name);
+
+  const ROUTE key = route_key(application_name, notification_name);
+  G_LOCK(routes);
+  const gboolean stored = routes != NULL;
+  if (stored) {
+    g_hash_table_remove(routes, &key);
+    if (route) g_hash_table_replace(routes, route, route);
+  }
+  G_UNLOCK(routes);
+  if (route && !stored) free_route(route);
+}
+
+static void
+unload_routes() {
+  G_LOCK(routes);
+  if (routes) g_hash_table_destroy(routes);
+  routes = NULL;
+  G_UNLOCK(routes);
+}
+
+// Guards the REGISTER latency and rollup figures.
+G_LOCK_DEFINE_STATIC(registration);
+static guint register_count;
+static gint64 register_usec_total;
+static gint64 register_usec_max;
+
+static void
+record_register_latency(const gint64 usec) {
+  G_LOCK(registration);
+  register_count++;
+  register_usec_total += usec;
+  if (usec > register_usec_max) register_usec_max = usec;
+  G_UNLOCK(registration);
+}
+
+static gboolean rollup_table_ready;
+static guint rollup_flushes;
+static guint rollup_rows;
+
+static void
+write_rollup(const gint period, const gint minute,
+    const gchar* const application_name, const gchar* const notification_name,
+    const guint count, gpointer GOL_UNUSED_ARG(user_data)) {
+  // Two steps rather than an upsert, which older SQLite doesn't have.
+  exec_sqlite3("insert or ignore into rollup(period, minute, app_name, name, count)"
+      " values(%d, %d, '%q', '%q', 0)",
+      period, minute, application_name, notification_name);
+  exec_sqlite3("update rollup set count = count + %d"
+      " where period = %d and minute = %d and app_name = '%q' and name = '%q'",
+      (gint) count, period, minute, application_name, notification_name);
+}
+
+// Adds the counts gathered since the last flush to the rollup table, one
+// transaction a minute however many notifications came in. Minute rows are
+// only read for the last hour, so a day of them is kept; hour rows as long
+// as the history itself.
+static void
+flush_rollups() {
+  if (!db) return;
+  begin_sqlite3();
+  if (!rollup_table_ready) {
+    rollup_table_ready = sqlite3_exec(db, "create table if not exists rollup"
+        "(period int not null, minute int not null,"
+        " app_name text not null, name text not null, count int not null,"
+        " primary key(period, minute, app_name, name))",
+        NULL, NULL, NULL) == SQLITE_OK;
+    if (!rollup_table_ready) {
+      gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+      commit_sqlite3();
+      return;
+    }
+  }
+  const guint rows = rollup_drain(write_rollup, NULL);
+  const gint now = (gint) (time(NULL) / 60);
+  exec_sqlite3("delete from rollup where period = %d and minute < %d",
+      ROLLUP_MINUTE, now - 24 * 60);
+  const gint max_age = get_config_value("history_max_age", 0);
+  if (max_age > 0)
+    exec_sqlite3("delete from rollup where period = %d and minute < %d",
+        ROLLUP_HOUR, now - max_age * 24 * 60);
+  commit_sqlite3();
+  G_LOCK(registration);
+  rollup_rows += rows;
+  rollup_flushes++;
+  G_UNLOCK(registration);
+}
+
+static gboolean
+flush_rollups_timer(gpointer GOL_UNUSED_ARG(user_data)) {
+  flush_rollups();
+  return TRUE;
+}
+
+typedef struct {
+  guint64 fingerprint;
+  gint64 last_seen; // monotonic usec
+} REGISTRATION;
+
+// Application name -> REGISTRATION of its last accepted REGISTER.
+static GHashTable* registrations;
+static guint registers_skipped;
+G_LOCK_DEFINE_STATIC(registrations);
+
+// Hash of the REGISTER headers, one line at a time with the line ending
+// and trailing blanks dropped. Resources are covered by their identifiers,
+// which GNTP derives from their content; hashing stops at the first NUL,
+// so binary data never is. Also returns the application name.
+static guint64
+registration_fingerprint(const char* p, gchar** const application_name) {
+  guint64 hash = GOL_HASH64_INIT;
+  *application_name = NULL;
+  while (*p) {
+    const char* const end = p + strcspn(p, "\r\n");
+    const char* last = end;
+    while (last > p && (last[-1] == ' ' || last[-1] == '\t')) last--;
+    hash = gol_hash64(hash, p, last - p);
+    hash = gol_hash64(hash, "\n", 1);
+
+    if (!*application_name && !strncmp(p, "Application-Name:", 17)) {
+      const char* value = p + 17;
+      while (value < last && (*value == ' ' || *value == '\t')) value++;
+      *application_name = g_strndup(value, last - value);
+    }
+
+    p = end;
+    if (*p == '\r') p++;
+    if (*p == '\n') p++;
+  }
+  return hash;
+}
+
+// TRUE if the application's last accepted REGISTER was identical; it is
+// then marked as seen again.
+static gboolean
+registration_unchanged(const gchar* const application_name, const guint64 fingerprint) {
+  if (!application_name) return FALSE;
+  G_LOCK(registrations);
+  REGISTRATION* const r = registrations
+    ? (REGISTRATION*) g_hash_table_lookup(registrations, application_name)
+    : NULL;
+  const gboolean unchanged = r && r->fingerprint == fingerprint;
+  if (unchanged) {
+    r->last_seen = g_get_monotonic_time();
+    registers_skipped++;
+  }
+  G_UNLOCK(registrations);
+  return unchanged;
+}
+
+static void
+remember_registration(const gchar* const application_name, const guint64 fingerprint) {
+  if (!application_name) return;
+  G_LOCK(registrations);
+  if (!registrations)
+    registrations = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  REGISTRATION* const r = g_new(REGISTRATION, 1);
+  r->fingerprint = fingerprint;
+  r->last_seen = g_get_monotonic_time();
+  g_hash_table_replace(registrations, g_strdup(application_name), r);
+  G_UNLOCK(registrations);
+}
+
+// Its rows are gone, so the next REGISTER has to go through in full.
+static void
+forget_registration(const gchar* const application_name) {
+  G_LOCK(registrations);
+  if (registrations) g_hash_table_remove(registrations, application_name);
+  G_UNLOCK(registrations);
+}
+
+static void
+unload_registrations() {
+  G_LOCK(registrations);
+  if (registrations) g_hash_table_destroy(registrations);
+  registrations = NULL;
+  G_UNLOCK(registrations);
+}
+
+static gboolean
+lookup_route(const char* const application_name, const char* const notification_name,
+    ROUTE* const route) {
+  const ROUTE key = route_key(application_name, notification_name);
+  G_LOCK(routes);
+  const ROUTE* const found = routes ? (const ROUTE*) g_hash_table_lookup(routes, &key) : NULL;
+  if (found) {
+    // The names belong to the table.
+    *route = *found;
+    route->application_name = route->notification_name = NULL;
+  }
+  G_UNLOCK(routes);
+  return found != NULL;
+}
+
 static bool
 get_tree_model_from_selection(gchar** const restrict pname, GtkTreeSelection* const restrict selection) {
   GtkTreeIter iter;
@@ -413,17 +851,6 @@ get_tree_model_from_tree(gchar** const restrict pname, GtkWidget* const restrict
   return get_tree_model_from_selection(pname, selection);
 }
 
-static GtkTreeIter
-list_store_set_before_prepand(GtkListStore* const list_store, ...) {
-  va_list list;
-  va_start(list, list_store);
-  GtkTreeIter iter;
-  gtk_list_store_prepend(list_store, &iter);
-  gtk_list_store_set_valist(list_store, &iter, list);
-  va_end(list);
-  return iter;
-}
-
 static GtkTreeIter
 list_store_set_after_append(GtkListStore* const list_store, ...) {
   va_list list;
@@ -535,30 +962,1031 @@ set_as_default_clicked(GtkWidget* GOL_UNUSED_ARG(widget), gpointer user_data) {
     if (current_display->set_param)
       current_display->set_param(get_display_parameter(name, ""));
   }
-  g_free(name);
+  g_free(name);
+}
+
+static gboolean
+parameter_focus_out(GtkWidget* GOL_UNUSED_ARG(widget), GdkEvent* GOL_UNUSED_ARG(event), gpointer user_data) {
+  GtkTreeSelection* selection = (GtkTreeSelection*) user_data;
+  gchar* name;
+  if (!get_tree_model_from_selection(&name, selection)) return FALSE;
+
+  bool
+  is_selection_name(const DISPLAY_PLUGIN* dp) {
+    return !g_ascii_strcasecmp(dp->name(), name);
+  }
+  DISPLAY_PLUGIN* const dp = find_display_plugin(is_selection_name);
+  if (dp) {
+    GtkWidget* const entry = (GtkWidget*) get_data_as_object(user_data, "parameter");
+    const gchar* param = gtk_entry_get_text(GTK_ENTRY(entry));
+    dp->set_param(param);
+    set_display_parameter(name, param);
+  }
+  g_free(name);
+  return FALSE;
+}
+
+typedef struct {
+  DISPLAY_PLUGIN* dp;
+  NOTIFICATION_INFO* ni;
+  gchar* application_name;
+  gchar* notification_name;
+  gchar* source; // sender address, NULL for local sources
+  gchar* coalescing_id;
+  gint64 queued;
+  guint64 hash; // 0 when not deduplicated
+} DISPLAY_REQUEST;
+
+static DISPLAY_REQUEST*
+display_request_new(DISPLAY_PLUGIN* const dp, NOTIFICATION_INFO* const ni,
+    const gchar* const application_name, const gchar* const notification_name,
+    const gchar* const source) {
+  DISPLAY_REQUEST* const dr = g_new0(DISPLAY_REQUEST, 1);
+  dr->dp = dp;
+  dr->ni = ni;
+  dr->application_name = g_strdup(application_name);
+  dr->notification_name = g_strdup(notification_name);
+  dr->source = g_strdup(source);
+  return dr;
+}
+
+static void
+free_display_request(DISPLAY_REQUEST* const dr) {
+  if (!dr) return;
+  free_notification_info(dr->ni);
+  g_free(dr->application_name);
+  g_free(dr->notification_name);
+  g_free(dr->source);
+  g_free(dr->coalescing_id);
+  g_free(dr);
+}
+
+// Hands the notification over to the display plugin, which owns it from now on.
+static void
+display_request_show(DISPLAY_REQUEST* const dr) {
+  DISPLAY_PLUGIN* const dp = dr->dp ? dr->dp : current_display;
+  dp->show(dr->ni);
+  dr->ni = NULL;
+  free_display_request(dr);
+}
+
+#define COALESCE_SUMMARY_LINES (5)
+
+static void schedule_request(DISPLAY_REQUEST* dr);
+
+static gint coalesce_window;
+static gint coalesce_burst;
+static GHashTable* coalesce_buckets;
+
+typedef struct {
+  gchar* key;
+  gchar* application_name;
+  guint timer;
+  guint shown;
+  guint count;
+  GQueue held; // latest COALESCE_SUMMARY_LINES requests only
+} COALESCE_BUCKET;
+
+static void
+free_coalesce_bucket(gpointer data) {
+  COALESCE_BUCKET* const cb = (COALESCE_BUCKET*) data;
+  if (cb->timer) g_source_remove(cb->timer);
+  DISPLAY_REQUEST* dr;
+  while ((dr = (DISPLAY_REQUEST*) g_queue_pop_head(&cb->held)))
+    free_display_request(dr);
+  g_free(cb->application_name);
+  g_free(cb);
+}
+
+static DISPLAY_REQUEST*
+coalesce_summary(COALESCE_BUCKET* const cb) {
+  const DISPLAY_REQUEST* const latest = (const DISPLAY_REQUEST*) g_queue_peek_tail(&cb->held);
+
+  GString* const text = g_string_new(NULL);
+  for (GList* it = cb->held.tail; it; it = it->prev) {
+    if (text->len) g_string_append_c(text, '\n');
+    g_string_append(text, ((const DISPLAY_REQUEST*) it->data)->ni->title);
+  }
+  if (cb->count > cb->held.length)
+    g_string_append_printf(text, "\n(and %u more)", cb->count - cb->held.length);
+
+  NOTIFICATION_INFO* const ni = g_new0(NOTIFICATION_INFO, 1);
+  ni->title = g_strdup_printf("%u new from %s", cb->count, cb->application_name);
+  ni->text = g_string_free(text, FALSE);
+  ni->icon = g_strdup(latest->ni->icon);
+  ni->local = latest->ni->local;
+  ni->timeout = latest->ni->timeout;
+  ni->priority = latest->ni->priority;
+
+  DISPLAY_REQUEST* const summary =
+    display_request_new(latest->dp, ni, cb->application_name, NULL, NULL);
+
+  DISPLAY_REQUEST* dr;
+  while ((dr = (DISPLAY_REQUEST*) g_queue_pop_head(&cb->held)))
+    free_display_request(dr);
+  cb->count = 0;
+  return summary;
+}
+
+static gboolean
+coalesce_window_closed(gpointer data) {
+  COALESCE_BUCKET* const cb = (COALESCE_BUCKET*) data;
+  if (!cb->count) {
+    // Quiet for a whole window; the next one starts from scratch.
+    cb->timer = 0;
+    g_hash_table_remove(coalesce_buckets, cb->key);
+    return FALSE;
+  }
+
+  schedule_request(cb->count == 1
+      ? (DISPLAY_REQUEST*) g_queue_pop_head(&cb->held)
+      : coalesce_summary(cb));
+  cb->count = 0;
+  return TRUE; // keep summarizing while the burst lasts
+}
+
+// Returns TRUE if the request was held back to be summarized later.
+static gboolean
+coalesce_request(DISPLAY_REQUEST* const dr) {
+  if (coalesce_window < 0 || !dr->application_name || dr->coalescing_id
+      || dr->ni->sticky || dr->ni->priority >= PRIORITY_MAX)
+    return FALSE;
+
+  if (!coalesce_buckets)
+    coalesce_buckets = g_hash_table_new_full(
+        g_str_hash, g_str_equal, g_free, free_coalesce_bucket);
+
+  gchar* const key = g_strconcat(dr->application_name, "\n",
+      dr->notification_name ? dr->notification_name : "", NULL);
+  COALESCE_BUCKET* cb = (COALESCE_BUCKET*) g_hash_table_lookup(coalesce_buckets, key);
+  if (cb) {
+    g_free(key);
+  } else {
+    cb = g_new0(COALESCE_BUCKET, 1);
+    cb->key = key;
+    cb->application_name = g_strdup(dr->application_name);
+    g_queue_init(&cb->held);
+    cb->timer = g_timeout_add(coalesce_window, coalesce_window_closed, cb);
+    g_hash_table_insert(coalesce_buckets, key, cb);
+  }
+
+  if (cb->shown < (guint) coalesce_burst) {
+    cb->shown++;
+    return FALSE;
+  }
+
+  // Everything is already in the history; only keep what the summary lists.
+  g_queue_push_tail(&cb->held, dr);
+  if (cb->held.length > COALESCE_SUMMARY_LINES)
+    free_display_request((DISPLAY_REQUEST*) g_queue_pop_head(&cb->held));
+  cb->count++;
+  return TRUE;
+}
+
+static void
+unload_coalesce_buckets() {
+  if (coalesce_buckets) g_hash_table_destroy(coalesce_buckets);
+  coalesce_buckets = NULL;
+}
+
+static RULE_SET* rule_set;
+static guint rule_evaluations;
+static guint rule_drops;
+static gint64 rule_usec_total;
+static gint64 rule_usec_max;
+
+// Swaps in the new rules only if every line compiles, so a typo never
+// leaves a half-built set behind.
+static gboolean
+load_rules(const gchar* const source, GError** const error) {
+  RULE_SET* const compiled = rule_set_compile(source, error);
+  if (!compiled) return FALSE;
+
+  RULE_SET* const old = rule_set;
+  rule_set = rule_set_size(compiled) ? compiled : NULL;
+  if (!rule_set) rule_set_free(compiled);
+  rule_set_free(old);
+  return TRUE;
+}
+
+static void
+unload_rules() {
+  rule_set_free(rule_set);
+  rule_set = NULL;
+}
+
+// Returns TRUE if a rule dropped the request.
+static gboolean
+apply_rules(DISPLAY_REQUEST* const dr) {
+  if (!rule_set) return FALSE;
+
+  const RULE_SUBJECT subject = {
+    .application_name  = dr->application_name,
+    .notification_name = dr->notification_name,
+    .title             = dr->ni->title,
+    .text              = dr->ni->text,
+    .source            = dr->source,
+  };
+  RULE_VERDICT verdict;
+  const gint64 start = g_get_monotonic_time();
+  rule_set_evaluate(rule_set, &subject, &verdict);
+  const gint64 elapsed = g_get_monotonic_time() - start;
+  rule_evaluations++;
+  rule_usec_total += elapsed;
+  if (elapsed > rule_usec_max) rule_usec_max = elapsed;
+
+  if (verdict.drop) {
+    rule_drops++;
+    return TRUE;
+  }
+  if (verdict.display) {
+    bool
+    is_rule_display(const DISPLAY_PLUGIN* dp) {
+      return !g_ascii_strcasecmp(dp->name(), verdict.display);
+    }
+    DISPLAY_PLUGIN* const dp = find_display_plugin(is_rule_display);
+    if (dp) dr->dp = dp;
+  }
+  if (verdict.set_priority) dr->ni->priority = verdict.priority;
+  if (verdict.sticky) dr->ni->sticky = TRUE;
+  return FALSE;
+}
+
+static gint dedupe_ttl;
+static guint dedupe_slots;
+static DEDUPE_TABLE* dedupe_table;
+static guint suppressed_duplicates;
+
+static guint64
+display_request_hash(const DISPLAY_REQUEST* const dr) {
+  guint64 hash = GOL_HASH64_INIT;
+  hash = gol_hash64_string(hash, dr->application_name);
+  hash = gol_hash64_string(hash, dr->notification_name);
+  hash = gol_hash64_string(hash, dr->ni->title);
+  hash = gol_hash64_string(hash, dr->ni->text);
+  return hash;
+}
+
+static void refresh_visible(const NOTIFICATION_INFO* ni, gint repeat);
+
+// Returns TRUE if the request repeats one seen within dedupe_ttl; it is then
+// folded into the first one's repeat count instead of popping up again.
+static gboolean
+dedupe_request(DISPLAY_REQUEST* const dr) {
+  // Previews and subscriptions have no application to key on.
+  if (dedupe_ttl < 0 || !dr->application_name) return FALSE;
+  if (!dedupe_table) dedupe_table = dedupe_new(dedupe_slots, dedupe_ttl);
+
+  gboolean duplicate;
+  dr->hash = display_request_hash(dr);
+  DEDUPE_ENTRY* const e = dedupe_lookup(
+      dedupe_table, dr->hash, g_get_monotonic_time(), &duplicate);
+  if (!duplicate) return FALSE;
+
+  suppressed_duplicates++;
+  // Still waiting or coalesced: the count is picked up if it gets shown.
+  if (e->data) refresh_visible((const NOTIFICATION_INFO*) e->data, e->count);
+  return TRUE;
+}
+
+// The notification is about to become visible; remember it so repeats can
+// find it.
+static void
+dedupe_attach(NOTIFICATION_INFO* const ni, const guint64 hash) {
+  if (!hash || !dedupe_table) return;
+  DEDUPE_ENTRY* const e = dedupe_find(dedupe_table, hash, g_get_monotonic_time());
+  if (!e) return;
+  e->data = ni;
+  if (e->count > 1) ni->repeat = e->count;
+}
+
+static void
+dedupe_detach(const NOTIFICATION_INFO* const ni, const guint64 hash) {
+  if (!hash || !dedupe_table) return;
+  DEDUPE_ENTRY* const e = dedupe_find(dedupe_table, hash, g_get_monotonic_time());
+  if (e && e->data == ni) e->data = NULL;
+}
+
+static void
+unload_dedupe_table() {
+  dedupe_free(dedupe_table);
+  dedupe_table = NULL;
+}
+
+static const char* const priority_names[PRIORITY_LEVELS] = {
+  "very low", "moderate", "normal", "high", "emergency",
+};
+
+static gint max_visible;
+static gint overflow_limit;
+static guint expired_requests;
+static guint preempted_popups;
+
+typedef struct {
+  const NOTIFICATION_INFO* ni;
+  gint priority;
+  gboolean expiring;
+  guint64 hash;
+  gchar* coalescing_key;
+} VISIBLE_POPUP;
+
+static void
+free_visible_popup(VISIBLE_POPUP* const vp) {
+  g_free(vp->coalescing_key);
+  g_free(vp);
+}
+
+static GList*
+find_visible(const NOTIFICATION_INFO* const ni, DISPLAY_PLUGIN** const dpp) {
+  for (GList* it = display_plugins; it; it = it->next) {
+    DISPLAY_PLUGIN* const dp = (DISPLAY_PLUGIN*) it->data;
+    for (GList* v = dp->visible; v; v = v->next) {
+      if (((VISIBLE_POPUP*) v->data)->ni != ni) continue;
+      *dpp = dp;
+      return v;
+    }
+  }
+  return NULL;
+}
+
+static GHashTable* coalescing_ids; // "app\nid" -> NOTIFICATION_INFO* on screen
+static guint coalescing_updates;
+
+static gchar*
+coalescing_key(const DISPLAY_REQUEST* const dr) {
+  return g_strconcat(dr->application_name ? dr->application_name : "", "\n",
+      dr->coalescing_id, NULL);
+}
+
+// The newest popup owns the ID. One the display couldn't update in place
+// is cut short rather than left on screen with stale content.
+static gchar*
+track_coalescing_id(const DISPLAY_REQUEST* const dr) {
+  if (!coalescing_ids)
+    coalescing_ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  gchar* const key = coalescing_key(dr);
+  NOTIFICATION_INFO* const old = (NOTIFICATION_INFO*) g_hash_table_lookup(coalescing_ids, key);
+  DISPLAY_PLUGIN* dp;
+  if (old && find_visible(old, &dp) && dp->expire) dp->expire(old);
+  g_hash_table_replace(coalescing_ids, g_strdup(key), dr->ni);
+  return key;
+}
+
+static void
+untrack_coalescing_id(const VISIBLE_POPUP* const vp) {
+  if (!vp->coalescing_key || !coalescing_ids) return;
+  if (g_hash_table_lookup(coalescing_ids, vp->coalescing_key) == vp->ni)
+    g_hash_table_remove(coalescing_ids, vp->coalescing_key);
+}
+
+static void
+unload_coalescing_ids() {
+  if (coalescing_ids) g_hash_table_destroy(coalescing_ids);
+  coalescing_ids = NULL;
+}
+
+static gint
+priority_level(const gint priority) {
+  return CLAMP(priority, PRIORITY_MIN, PRIORITY_MAX) - PRIORITY_MIN;
+}
+
+// Number of popups the display can hold at once, 0 if it doesn't care.
+static guint
+display_slots(const DISPLAY_PLUGIN* const dp) {
+  guint slots = max_visible > 0 ? (guint) max_visible : 0;
+  const gint capacity = dp->capacity ? dp->capacity() : 0;
+  if (capacity > 0 && (!slots || (guint) capacity < slots)) slots = capacity;
+  return slots;
+}
+
+static gboolean
+display_is_full(const DISPLAY_PLUGIN* const dp) {
+  const guint slots = display_slots(dp);
+  return slots && g_list_length(dp->visible) >= slots;
+}
+
+static guint
+display_waiting(const DISPLAY_PLUGIN* const dp) {
+  guint count = 0;
+  for (gint level = 0; level < PRIORITY_LEVELS; ++level)
+    count += g_queue_get_length((GQueue*) &dp->waiting[level]);
+  return count;
+}
+
+// Make room in the overflow queue: the oldest request of the lowest
+// priority that has any goes first.
+static void
+drop_oldest_waiting(DISPLAY_PLUGIN* const dp) {
+  for (gint level = 0; level < PRIORITY_LEVELS; ++level) {
+    DISPLAY_REQUEST* const dr = (DISPLAY_REQUEST*) g_queue_pop_head(&dp->waiting[level]);
+    if (!dr) continue;
+    dp->dropped++;
+    free_display_request(dr);
+    return;
+  }
+}
+
+// Highest priority first. Below-normal requests that waited longer than they
+// would have been shown are stale by now and get dropped on the way.
+static DISPLAY_REQUEST*
+next_waiting_request(DISPLAY_PLUGIN* const dp) {
+  const gint64 now = g_get_monotonic_time();
+  for (gint level = PRIORITY_LEVELS; level--;) {
+    DISPLAY_REQUEST* dr;
+    while ((dr = (DISPLAY_REQUEST*) g_queue_pop_head(&dp->waiting[level]))) {
+      if (level < priority_level(0)
+          && now - dr->queued > (gint64) dr->ni->timeout * 10000) {
+        expired_requests++;
+        free_display_request(dr);
+        continue;
+      }
+      return dr;
+    }
+  }
+  return NULL;
+}
+
+static void
+pump_display(DISPLAY_PLUGIN* const dp) {
+  // show() may report a popup closed right away; the loop below picks that up.
+  if (dp->pumping) return;
+  dp->pumping = TRUE;
+
+  DISPLAY_REQUEST* dr;
+  while (!display_is_full(dp) && (dr = next_waiting_request(dp))) {
+    VISIBLE_POPUP* const vp = g_new0(VISIBLE_POPUP, 1);
+    vp->ni = dr->ni;
+    vp->priority = dr->ni->priority;
+    vp->hash = dr->hash;
+    dp->visible = g_list_append(dp->visible, vp);
+    if (dr->coalescing_id) vp->coalescing_key = track_coalescing_id(dr);
+    dedupe_attach(dr->ni, dr->hash);
+    display_request_show(dr);
+  }
+
+  dp->pumping = FALSE;
+}
+
+// Make room for an emergency by cutting short the least important popup.
+static void
+preempt_visible(DISPLAY_PLUGIN* const dp, const gint priority) {
+  if (!dp->expire) return;
+
+  VISIBLE_POPUP* victim = NULL;
+  for (GList* it = dp->visible; it; it = it->next) {
+    VISIBLE_POPUP* const vp = (VISIBLE_POPUP*) it->data;
+    if (vp->expiring || vp->priority >= priority) continue;
+    if (!victim || vp->priority < victim->priority) victim = vp;
+  }
+  if (victim && dp->expire((NOTIFICATION_INFO*) victim->ni)) {
+    victim->expiring = TRUE;
+    preempted_popups++;
+  }
+}
+
+static void
+schedule_request(DISPLAY_REQUEST* const dr) {
+  DISPLAY_PLUGIN* const dp = dr->dp ? dr->dp : current_display;
+  dr->dp = dp;
+  dr->queued = g_get_monotonic_time();
+  g_queue_push_tail(&dp->waiting[priority_level(dr->ni->priority)], dr);
+
+  if (dr->ni->priority >= PRIORITY_MAX && display_is_full(dp))
+    preempt_visible(dp, dr->ni->priority);
+  pump_display(dp);
+
+  while (overflow_limit > 0 && display_waiting(dp) > (guint) overflow_limit)
+    drop_oldest_waiting(dp);
+}
+
+static void
+refresh_visible(const NOTIFICATION_INFO* const ni, const gint repeat) {
+  DISPLAY_PLUGIN* dp;
+  if (!find_visible(ni, &dp)) return;
+  // Popups the display can't redraw just keep their old count.
+  ((NOTIFICATION_INFO*) ni)->repeat = repeat;
+  if (dp->refresh) dp->refresh((NOTIFICATION_INFO*) ni);
+}
+
+static void
+display_closed(const NOTIFICATION_INFO* const ni) {
+  DISPLAY_PLUGIN* dp;
+  GList* const v = find_visible(ni, &dp);
+  if (!v) return;
+  VISIBLE_POPUP* const vp = (VISIBLE_POPUP*) v->data;
+  dedupe_detach(vp->ni, vp->hash);
+  untrack_coalescing_id(vp);
+  dp->visible = g_list_delete_link(dp->visible, v);
+  free_visible_popup(vp);
+  pump_display(dp);
+}
+
+static void
+swap_notification_info(NOTIFICATION_INFO* const a, NOTIFICATION_INFO* const b) {
+  const NOTIFICATION_INFO tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+// Returns TRUE if the request carried new content for a coalescing ID that
+// is already on screen or waiting, and was folded into it.
+static gboolean
+update_coalesced(DISPLAY_REQUEST* const dr) {
+  if (!dr->coalescing_id) return FALSE;
+
+  gchar* const key = coalescing_key(dr);
+  NOTIFICATION_INFO* const live = coalescing_ids
+    ? (NOTIFICATION_INFO*) g_hash_table_lookup(coalescing_ids, key) : NULL;
+  g_free(key);
+
+  DISPLAY_PLUGIN* dp;
+  GList* const v = live ? find_visible(live, &dp) : NULL;
+  if (v && dp->refresh) {
+    // The display keys its popup on the pointer, so only the contents move.
+    VISIBLE_POPUP* const vp = (VISIBLE_POPUP*) v->data;
+    swap_notification_info(live, dr->ni);
+    vp->priority = live->priority;
+    dedupe_detach(live, vp->hash);
+    vp->hash = dr->hash;
+    dedupe_attach(live, vp->hash);
+    dp->refresh(live);
+    coalescing_updates++;
+    free_display_request(dr);
+    return TRUE;
+  }
+
+  // Not shown yet: replace what is waiting, which keeps its place in line
+  // unless the priority changed; then it goes to the back of its new one.
+  for (GList* it = display_plugins; it; it = it->next) {
+    DISPLAY_PLUGIN* const wp = (DISPLAY_PLUGIN*) it->data;
+    for (gint level = 0; level < PRIORITY_LEVELS; ++level) {
+      for (GList* w = wp->waiting[level].head; w; w = w->next) {
+        DISPLAY_REQUEST* const queued = (DISPLAY_REQUEST*) w->data;
+        if (!queued->coalescing_id
+            || strcmp(queued->coalescing_id, dr->coalescing_id)
+            || g_strcmp0(queued->application_name, dr->application_name))
+          continue;
+        swap_notification_info(queued->ni, dr->ni);
+        queued->hash = dr->hash;
+        coalescing_updates++;
+        free_display_request(dr);
+        const gint moved = priority_level(queued->ni->priority);
+        if (moved != level) {
+          g_queue_delete_link(&wp->waiting[level], w);
+          g_queue_push_tail(&wp->waiting[moved], queued);
+          if (queued->ni->priority >= PRIORITY_MAX && display_is_full(wp))
+            preempt_visible(wp, queued->ni->priority);
+          pump_display(wp);
+        }
+        return TRUE;
+      }
+    }
+  }
+  return FALSE;
+}
+
+static DISPLAY_CONTEXT dc = {
+  display_closed,
+  icon_cache_get,
+};
+
+#define DND_DIGEST_LINES (8)
+
+typedef struct {
+  gchar* application_name;
+  guint count; // everything received while away, evicted ones included
+} DND_APP;
+
+static gint dnd_buffer_size;
+static GQueue dnd_held; // DISPLAY_REQUEST*, oldest first
+static GHashTable* dnd_apps;
+static gsize dnd_bytes;
+static guint dnd_evicted;
+
+static void
+free_dnd_app(gpointer data) {
+  DND_APP* const app = (DND_APP*) data;
+  g_free(app->application_name);
+  g_free(app);
+}
+
+static gsize
+display_request_size(const DISPLAY_REQUEST* const dr) {
+  gsize
+  length(const gchar* const str) {
+    return str ? strlen(str) + 1 : 0;
+  }
+  const NOTIFICATION_INFO* const ni = dr->ni;
+  return sizeof(*dr) + sizeof(*ni)
+    + length(ni->title) + length(ni->text) + length(ni->icon) + length(ni->url)
+    + length(dr->application_name) + length(dr->notification_name)
+    + length(dr->source) + length(dr->coalescing_id);
+}
+
+static void
+dnd_clear() {
+  DISPLAY_REQUEST* dr;
+  while ((dr = (DISPLAY_REQUEST*) g_queue_pop_head(&dnd_held)))
+    free_display_request(dr);
+  if (dnd_apps) g_hash_table_remove_all(dnd_apps);
+  dnd_bytes = 0;
+  dnd_evicted = 0;
+}
+
+static void
+dnd_hold(DISPLAY_REQUEST* const dr) {
+  if (!dnd_apps)
+    dnd_apps = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_dnd_app);
+
+  const gchar* const name = dr->application_name ? dr->application_name : "";
+  DND_APP* app = (DND_APP*) g_hash_table_lookup(dnd_apps, name);
+  if (!app) {
+    app = g_new0(DND_APP, 1);
+    app->application_name = g_strdup(name);
+    g_hash_table_insert(dnd_apps, app->application_name, app);
+  }
+  app->count++;
+
+  // Progress updates only need their latest state kept.
+  if (dr->coalescing_id) {
+    for (GList* it = dnd_held.head; it; it = it->next) {
+      DISPLAY_REQUEST* const held = (DISPLAY_REQUEST*) it->data;
+      if (!held->coalescing_id || strcmp(held->coalescing_id, dr->coalescing_id)
+          || g_strcmp0(held->application_name, dr->application_name))
+        continue;
+      dnd_bytes -= display_request_size(held);
+      swap_notification_info(held->ni, dr->ni);
+      dnd_bytes += display_request_size(held);
+      free_display_request(dr);
+      return;
+    }
+  }
+
+  g_queue_push_tail(&dnd_held, dr);
+  dnd_bytes += display_request_size(dr);
+  while (dnd_buffer_size > 0 && dnd_bytes > (gsize) dnd_buffer_size && dnd_held.length > 1) {
+    DISPLAY_REQUEST* const oldest = (DISPLAY_REQUEST*) g_queue_pop_head(&dnd_held);
+    dnd_bytes -= display_request_size(oldest);
+    free_display_request(oldest);
+    dnd_evicted++;
+  }
+}
+
+static void
+dnd_enter() {
+  // The previous session's leftovers are no longer interesting.
+  dnd_clear();
+}
+
+// One popup summing up what arrived; the items themselves stay available
+// from the "Missed Notifications" menu until the next session.
+static void
+dnd_leave() {
+  if (!dnd_apps || !g_hash_table_size(dnd_apps)) return;
+
+  gint
+  by_count(gconstpointer a, gconstpointer b) {
+    return (gint) ((const DND_APP*) b)->count - (gint) ((const DND_APP*) a)->count;
+  }
+  GList* const apps = g_list_sort(g_hash_table_get_values(dnd_apps), by_count);
+
+  guint total = 0, lines = 0;
+  GString* const text = g_string_new(NULL);
+  for (GList* it = apps; it; it = it->next) {
+    const DND_APP* const app = (const DND_APP*) it->data;
+    total += app->count;
+    if (lines++ >= DND_DIGEST_LINES) continue;
+    if (text->len) g_string_append_c(text, '\n');
+    g_string_append_printf(text, "%s: %u",
+        *app->application_name ? app->application_name : "Other", app->count);
+  }
+  if (lines > DND_DIGEST_LINES)
+    g_string_append_printf(text, "\n(and %u more applications)", lines - DND_DIGEST_LINES);
+  if (dnd_evicted)
+    g_string_append_printf(text, "\n%u oldest not kept", dnd_evicted);
+  g_list_free(apps);
+
+  NOTIFICATION_INFO* const ni = g_new0(NOTIFICATION_INFO, 1);
+  ni->title = g_strdup_printf("%u notifications while away", total);
+  ni->text = g_string_free(text, FALSE);
+  ni->icon = g_build_filename(DATADIR, "data", "mattn.png", NULL);
+  ni->local = TRUE;
+  ni->timeout = get_config_value("default_timeout", 5000)/10;
+  schedule_request(display_request_new(NULL, ni, NULL, NULL, NULL));
+}
+
+static void
+unload_dnd_buffer() {
+  dnd_clear();
+  if (dnd_apps) g_hash_table_destroy(dnd_apps);
+  dnd_apps = NULL;
+}
+
+static void
+show_notification(gpointer data) {
+  DISPLAY_REQUEST* const dr = (DISPLAY_REQUEST*) data;
+  if (apply_rules(dr) || dedupe_request(dr)) {
+    free_display_request(dr);
+    return;
+  }
+  if (update_coalesced(dr)) return;
+  if (gol_status == GOL_STATUS_DND) {
+    dnd_hold(dr);
+    return;
+  }
+  if (coalesce_request(dr)) return;
+  schedule_request(dr);
+}
+
+// NULL display means current_display as of when the main loop gets to it.
+static void
+push_notification(DISPLAY_PLUGIN* const dp, NOTIFICATION_INFO* const ni,
+    const gchar* const application_name, const gchar* const notification_name,
+    const gchar* const source) {
+  dispatch_push(show_notification,
+      display_request_new(dp, ni, application_name, notification_name, source),
+      (GDestroyNotify) free_display_request);
+}
+
+// Rows shown for a search in the settings dialog.
+#define HISTORY_SEARCH_LIMIT 1000
+
+// Entries of the Recent submenu.
+#define RECENT_MENU_ITEMS 10
+#define RECENT_MENU_LABEL_CHARS 60
+
+typedef struct {
+  gint64 serial; // from history_append()
+  gchar* received;
+  gchar* application_name;
+  gchar* title;
+  gchar* text;
+} HISTORY_ROW;
+
+// HISTORY_ROW* passed on to the main loop that the history writer may not
+// be done with yet, oldest first; they go once it is. Main loop only.
+static GQueue uncommitted;
+
+static void
+free_history_row(gpointer data) {
+  HISTORY_ROW* const row = (HISTORY_ROW*) data;
+  g_free(row->received);
+  g_free(row->application_name);
+  g_free(row->title);
+  g_free(row->text);
+  g_free(row);
+}
+
+static void
+recent_response(GtkDialog* dialog, gint GOL_UNUSED_ARG(response), gpointer GOL_UNUSED_ARG(user_data)) {
+  gtk_widget_destroy(GTK_WIDGET(dialog));
+}
+
+static void
+recent_item_activate(GtkMenuItem* menu_item, gpointer GOL_UNUSED_ARG(user_data)) {
+  GtkWidget* const dialog = gtk_message_dialog_new(NULL, 0,
+      GTK_MESSAGE_INFO, GTK_BUTTONS_CLOSE, "%s",
+      (const gchar*) get_data_as_object(menu_item, "title"));
+  gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s",
+      (const gchar*) get_data_as_object(menu_item, "details"));
+  gtk_window_set_title(GTK_WINDOW(dialog), "Recent Notification");
+  g_signal_connect(G_OBJECT(dialog), "response", G_CALLBACK(recent_response), NULL);
+  gtk_widget_show(dialog);
+}
+
+// Rebuilt once per burst of notifications, when the main loop is idle.
+static gboolean
+refresh_recent_menu(gpointer GOL_UNUSED_ARG(user_data)) {
+  recent_menu_refresh = 0;
+  if (!recent_menu) return FALSE;
+
+  void
+  destroy_child(GtkWidget* widget, gpointer GOL_UNUSED_ARG(data)) {
+    gtk_widget_destroy(widget);
+  }
+  gtk_container_foreach(GTK_CONTAINER(recent_menu), destroy_child, NULL);
+
+  const guint length = MIN(recent_length(recent), RECENT_MENU_ITEMS);
+  for (guint n = 0; n < length; ++n) {
+    const RECENT_ENTRY* const e = recent_get(recent, n);
+    gchar* label = g_strdup_printf("%s: %s", e->application_name, e->title);
+    if (g_utf8_strlen(label, -1) > RECENT_MENU_LABEL_CHARS) {
+      gchar* const end = g_utf8_offset_to_pointer(label, RECENT_MENU_LABEL_CHARS - 1);
+      *end = '\0';
+      gchar* const shortened = g_strconcat(label, "\xe2\x80\xa6", NULL);
+      g_free(label);
+      label = shortened;
+    }
+    GtkWidget* const menu_item = gtk_menu_item_new_with_label(label);
+    g_free(label);
+    g_object_set_data_full(G_OBJECT(menu_item), "title", g_strdup(e->title), g_free);
+    g_object_set_data_full(G_OBJECT(menu_item), "details",
+        g_strdup_printf("%s\n%s\n\n%s", e->received, e->application_name, e->text), g_free);
+    g_signal_connect(G_OBJECT(menu_item), "activate", G_CALLBACK(recent_item_activate), NULL);
+    gtk_menu_shell_append(GTK_MENU_SHELL(recent_menu), menu_item);
+  }
+  if (!length) {
+    GtkWidget* const menu_item = gtk_menu_item_new_with_label("None yet");
+    gtk_widget_set_sensitive(menu_item, FALSE);
+    gtk_menu_shell_append(GTK_MENU_SHELL(recent_menu), menu_item);
+  }
+  gtk_widget_show_all(recent_menu);
+  return FALSE;
+}
+
+static void
+schedule_recent_menu_refresh() {
+  if (!recent_menu_refresh) recent_menu_refresh = g_idle_add(refresh_recent_menu, NULL);
+}
+
+static void
+append_recent_menu_item(GtkMenuShell* const menu) {
+  GtkWidget* const menu_item = gtk_menu_item_new_with_label("Recent");
+  recent_menu = gtk_menu_new();
+  gtk_menu_item_set_submenu(GTK_MENU_ITEM(menu_item), recent_menu);
+  gtk_menu_shell_append(menu, menu_item);
+  refresh_recent_menu(NULL);
+}
+
+// The recent notifications as a list for the history tab, newest first.
+static GtkTreeModel*
+recent_model_new() {
+  GtkListStore* const store = gtk_list_store_new(
+      HISTORY_MODEL_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+  for (guint n = 0; n < recent_length(recent); ++n) {
+    const RECENT_ENTRY* const e = recent_get(recent, n);
+    list_store_set_after_append(store,
+        HISTORY_MODEL_RECEIVED, e->received,
+        HISTORY_MODEL_TITLE, e->title,
+        HISTORY_MODEL_TEXT, e->text,
+        -1);
+  }
+  return GTK_TREE_MODEL(store);
+}
+
+// Whole history, read from the database as rows scroll into view, on a
+// reader the model keeps until it is gone. Only made once asked for.
+static GtkTreeModel*
+get_history_model(gpointer dialog) {
+  GtkTreeModel* model = (GtkTreeModel*) get_data_as_object(dialog, "history_model");
+  if (model) return model;
+  if (history_log_dir) {
+    const gint64 newest = history_committed();
+    model = history_model_new_from_log(history_log_open(history_log_dir, FALSE), newest);
+  } else {
+    // Held for as long as the dialog is open, so not taken from the pool.
+    DB_READER* const reader = readers ? db_pool_open_dedicated(readers) : NULL;
+    sqlite3* const conn = reader ? reader->db : db;
+    sqlite3_int64 top;
+    const gint64 newest = history_snapshot(conn, &top);
+    model = history_model_new(conn, top, newest);
+    if (reader)
+      g_object_set_data_full(G_OBJECT(model), "reader", reader, (GDestroyNotify) db_pool_close_dedicated);
+  }
+  // Rows already shown elsewhere that are not written yet; the model skips
+  // those the snapshot has.
+  for (GList* it = uncommitted.head; it; it = it->next) {
+    const HISTORY_ROW* const row = (const HISTORY_ROW*) it->data;
+    history_model_prepend(model, row->serial, row->received, row->title, row->text);
+  }
+  g_object_set_data_full(G_OBJECT(dialog), "history_model", model, g_object_unref);
+  return model;
+}
+
+static void
+prepend_history_row(gpointer data) {
+  HISTORY_ROW* const row = (HISTORY_ROW*) data;
+  recent_push(recent, row->received, row->application_name, row->title, row->text);
+  schedule_recent_menu_refresh();
+  // Kept current while search results are shown, too.
+  if (setting_dialog) {
+    // The list of recent ones follows the ring.
+    GtkListStore* const store =
+      GTK_LIST_STORE(get_data_as_object(setting_dialog, "history_recent"));
+    GtkTreeIter iter;
+    gtk_list_store_insert_with_values(store, &iter, 0,
+        HISTORY_MODEL_RECEIVED, row->received,
+        HISTORY_MODEL_TITLE, row->title,
+        HISTORY_MODEL_TEXT, row->text,
+        -1);
+    const gint rows = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(store), NULL);
+    if (rows > (gint) recent_length(recent)
+        && gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(store), &iter, NULL, rows - 1))
+      gtk_list_store_remove(store, &iter);
+
+    GtkTreeModel* const model = (GtkTreeModel*) get_data_as_object(setting_dialog, "history_model");
+    if (model) history_model_prepend(model, row->serial, row->received, row->title, row->text);
+  }
+  g_queue_push_tail(&uncommitted, row);
+  const gint64 committed = history_committed();
+  while (uncommitted.head && ((HISTORY_ROW*) uncommitted.head->data)->serial <= committed)
+    free_history_row(g_queue_pop_head(&uncommitted));
 }
 
+// Fills the ring with the newest rows already in the history, once the
+// main loop is idle after startup, and again once a migration is done.
+// Notifications may have come in meanwhile, maybe not written yet; rows go
+// behind them, from before the oldest of them, so running twice is
+// harmless.
 static gboolean
-parameter_focus_out(GtkWidget* GOL_UNUSED_ARG(widget), GdkEvent* GOL_UNUSED_ARG(event), gpointer user_data) {
-  GtkTreeSelection* selection = (GtkTreeSelection*) user_data;
-  gchar* name;
-  if (!get_tree_model_from_selection(&name, selection)) return FALSE;
-
-  bool
-  is_selection_name(const DISPLAY_PLUGIN* dp) {
-    return !g_ascii_strcasecmp(dp->name(), name);
+seed_recent(gpointer GOL_UNUSED_ARG(user_data)) {
+  const RECENT_ENTRY* const oldest = recent_get(recent, recent_length(recent) - 1);
+  // Same format as current_timestamp(), so this sorts after every row.
+  const gchar* const before = oldest ? oldest->received : "9999";
+
+  gboolean
+  push_record(const HISTORY_RECORD* const record, gpointer GOL_UNUSED_ARG(data)) {
+    if (strcmp(record->received, before) >= 0) return TRUE;
+    return recent_push_oldest(recent, record->received, record->application_name,
+        record->title, record->text);
   }
-  DISPLAY_PLUGIN* const dp = find_display_plugin(is_selection_name);
-  if (dp) {
-    GtkWidget* const entry = (GtkWidget*) get_data_as_object(user_data, "parameter");
-    const gchar* param = gtk_entry_get_text(GTK_ENTRY(entry));
-    dp->set_param(param);
-    set_display_parameter(name, param);
+  void
+  push_rows(sqlite3_stmt* const stmt) {
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      if (!recent_push_oldest(recent,
+            (const gchar*) sqlite3_column_text(stmt, 0),
+            (const gchar*) sqlite3_column_text(stmt, 1),
+            (const gchar*) sqlite3_column_text(stmt, 2),
+            (const gchar*) sqlite3_column_text(stmt, 3)))
+        break;
+    }
   }
-  g_free(name);
+
+  if (history_log_dir) {
+    HISTORY_LOG* const log = history_log_open(history_log_dir, FALSE);
+    history_log_foreach(log, 0, push_record, NULL);
+    history_log_close(log);
+  } else if (g_atomic_int_get(&migration_step) >= migration_steps) {
+    // Before the migration is done the table may not be there yet;
+    // migration_done() schedules this again.
+    statement_sqlite3(push_rows,
+        "select received, app_name, history_text(title), history_text(text)"
+        " from notification where received < '%q' order by received desc limit %d",
+        before, recent_size);
+  }
+  schedule_recent_menu_refresh();
   return FALSE;
 }
 
+// With no query, the recent notifications, or the whole history if asked
+// for; otherwise a list of what matches `query`.
+static void
+load_history(gpointer dialog, const gchar* const query) {
+  GtkTreeView* const view = GTK_TREE_VIEW(get_data_as_object(dialog, "history_view"));
+  if (!query || !*query) {
+    const gboolean all = gtk_toggle_button_get_active(
+        GTK_TOGGLE_BUTTON(get_data_as_object(dialog, "history_all")));
+    gtk_tree_view_set_model(view, all
+        ? get_history_model(dialog)
+        : GTK_TREE_MODEL(get_data_as_object(dialog, "history_recent")));
+    return;
+  }
+
+  GtkListStore* const results = gtk_list_store_new(
+      HISTORY_MODEL_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+  void
+  append_result(const gchar* received, const gchar* GOL_UNUSED_ARG(application_name),
+      const gchar* title, const gchar* text, gpointer GOL_UNUSED_ARG(user_data)) {
+    list_store_set_after_append(results,
+        HISTORY_MODEL_RECEIVED, received,
+        HISTORY_MODEL_TITLE, title,
+        HISTORY_MODEL_TEXT, text,
+        -1);
+  }
+  if (history_log_dir) {
+    HISTORY_LOG* const log = history_log_open(history_log_dir, FALSE);
+    history_log_search(log, query, HISTORY_SEARCH_LIMIT, append_result, NULL);
+    history_log_close(log);
+  } else {
+    DB_READER* const reader = readers ? db_pool_acquire(readers) : NULL;
+    history_search(reader ? reader->db : db, query, HISTORY_SEARCH_LIMIT, append_result, NULL);
+    db_pool_release(reader);
+  }
+  gtk_tree_view_set_model(view, GTK_TREE_MODEL(results));
+  g_object_unref(results);
+}
+
+static void
+history_search_activate(GtkEntry* entry, gpointer user_data) {
+  load_history(user_data, gtk_entry_get_text(entry));
+}
+
+static void
+history_all_toggled(GtkToggleButton* GOL_UNUSED_ARG(button), gpointer user_data) {
+  load_history(user_data, gtk_entry_get_text(
+        GTK_ENTRY(get_data_as_object(user_data, "history_search"))));
+}
+
+// Same format as sqlite's current_timestamp.
+static gchar*
+current_timestamp() {
+  GDateTime* const now = g_date_time_new_now_utc();
+  gchar* const value = g_date_time_format(now, "%Y-%m-%d %H:%M:%S");
+  g_date_time_unref(now);
+  return value;
+}
+
 static void
 preview_clicked(GtkWidget* GOL_UNUSED_ARG(widget), gpointer user_data) {
   GtkTreeSelection* selection = (GtkTreeSelection*) user_data;
@@ -578,7 +2006,8 @@ preview_clicked(GtkWidget* GOL_UNUSED_ARG(widget), gpointer user_data) {
     ni->icon = g_build_filename(DATADIR, "data", "mattn.png", NULL);
     ni->local = TRUE;
     ni->timeout = get_config_value("default_timeout", 5000)/10;
-    g_idle_add((GSourceFunc) dp->show, ni);
+    // Asked for explicitly, so not subject to rules or do-not-disturb.
+    schedule_request(display_request_new(dp, ni, NULL, NULL, NULL));
   }
   g_free(name);
 }
@@ -624,11 +2053,12 @@ subscriber_enable_toggled(
   enable = !enable;
   gtk_list_store_set(GTK_LIST_STORE(model), &iter, 0, enable, -1);
 
+  begin_sqlite3();
   exec_sqlite3("delete from subscriber where name = '%q'", name);
-
   exec_sqlite3(
     "insert into subscriber(name, enable) values('%q', %d)",
     name, enable ? 1 : 0);
+  commit_sqlite3();
 
   bool
   is_model_name(const SUBSCRIBE_PLUGIN* sp) {
@@ -700,6 +2130,7 @@ notification_enable_changed(GtkComboBox *combobox, gpointer user_data) {
       "update application set enable = %d"
       " where app_name = '%q' and name = '%q'",
       enable, app_name, name);
+  reload_route(app_name, name);
 
   g_free(app_name);
   g_free(name);
@@ -724,6 +2155,7 @@ notification_display_changed(GtkComboBox *combobox, gpointer user_data) {
     "update application set display = '%q'"
     " where app_name = '%q' and name = '%q'",
     display, app_name, name);
+  reload_route(app_name, name);
 
   g_free(display);
   g_free(app_name);
@@ -761,11 +2193,15 @@ application_delete(GtkWidget* GOL_UNUSED_ARG(widget), gpointer user_data) {
     exec_sqlite3(
       "delete from application where app_name = '%q' and name = '%q'",
       app_name, name);
+    reload_route(app_name, name);
+    forget_registration(app_name);
     g_free(name);
 
     gtk_list_store_remove(GTK_LIST_STORE(model2), &iter2);
   } else {
     exec_sqlite3("delete from application where app_name = '%q'", app_name);
+    load_routes();
+    forget_registration(app_name);
     gtk_list_store_remove(GTK_LIST_STORE(model1), &iter1);
     gtk_list_store_clear(GTK_LIST_STORE(model2));
   }
@@ -832,6 +2268,158 @@ vertical_list_new(const char* const model_name, const char* const tree_name,
   return model;
 }
 
+static void
+append_statistics(GString* const stats) {
+  void
+  append_display(DISPLAY_PLUGIN* dp) {
+    const guint slots = display_slots(dp);
+    if (slots)
+      g_string_append_printf(stats, "%s: %u/%u visible; waiting",
+          dp->name(), g_list_length(dp->visible), slots);
+    else
+      g_string_append_printf(stats, "%s: %u visible; waiting",
+          dp->name(), g_list_length(dp->visible));
+    for (gint level = PRIORITY_LEVELS; level--;)
+      g_string_append_printf(stats, "%s %s %u",
+          level == PRIORITY_LEVELS - 1 ? "" : ",",
+          priority_names[level], g_queue_get_length(&dp->waiting[level]));
+    g_string_append_printf(stats, "; dropped %u\n", dp->dropped);
+  }
+  foreach_display_plugin(append_display);
+  g_string_append_printf(stats, "Expired while waiting: %u\n", expired_requests);
+  g_string_append_printf(stats, "Suppressed duplicates: %u (evicted %u)\n",
+      suppressed_duplicates, dedupe_table ? dedupe_evicted(dedupe_table) : 0);
+  g_string_append_printf(stats, "Preempted popups: %u\n", preempted_popups);
+  guint icons, icon_hits, icon_misses, icons_evicted;
+  gsize icon_bytes;
+  icon_cache_stats(&icons, &icon_bytes, &icon_hits, &icon_misses, &icons_evicted);
+  g_string_append_printf(stats,
+      "Icons: %u cached in %" G_GSIZE_FORMAT " bytes; %u hits, %u misses, %u evicted\n",
+      icons, icon_bytes, icon_hits, icon_misses, icons_evicted);
+  g_string_append_printf(stats, "Updated in place: %u\n", coalescing_updates);
+  guint hits, prepares;
+  stmt_cache_stats(stmt_cache, &hits, &prepares);
+  g_string_append_printf(stats, "SQL statements: %u reused, %u prepared\n", hits, prepares);
+  guint reader_count, leases, waits;
+  db_pool_stats(readers, &reader_count, &leases, &waits, &hits, &prepares);
+  g_string_append_printf(stats,
+      "Readers: %u connections, %u leases, %u waited; %u reused, %u prepared\n",
+      reader_count, leases, waits, hits, prepares);
+  if (migration_steps) {
+    const gint step = g_atomic_int_get(&migration_step);
+    if (step < migration_steps)
+      g_string_append_printf(stats, "Migration: step %d of %d\n", step, migration_steps);
+    else
+      g_string_append_printf(stats, "Migration: done in %.1f ms\n", migration_usec / 1000.0);
+  }
+  g_string_append_printf(stats, "Startup: listening after %.1f ms", (listening_at - startup_at) / 1000.0);
+  if (first_request_at)
+    g_string_append_printf(stats, ", first GNTP request after %.1f ms",
+        (first_request_at - startup_at) / 1000.0);
+  g_string_append_c(stats, '\n');
+  G_LOCK(registrations);
+  const guint skipped = registers_skipped;
+  G_UNLOCK(registrations);
+  G_LOCK(registration);
+  g_string_append_printf(stats, "REGISTER: %u handled, %u unchanged; %.2f ms avg, %.2f ms max\n",
+      register_count, skipped,
+      register_count ? register_usec_total / 1000.0 / register_count : 0.0,
+      register_usec_max / 1000.0);
+  G_UNLOCK(registration);
+  G_LOCK(registration);
+  g_string_append_printf(stats, "Rollups: %u rows in %u flushes\n", rollup_rows, rollup_flushes);
+  G_UNLOCK(registration);
+  guint history_rows, history_commits, history_expired;
+  history_stats(&history_rows, &history_commits, &history_expired);
+  g_string_append_printf(stats, "History: %u rows in %u commits, %u expired\n",
+      history_rows, history_commits, history_expired);
+  guint64 raw_bytes, stored_bytes;
+  guint dictionaries;
+  history_codec_stats(&raw_bytes, &stored_bytes, &dictionaries);
+  g_string_append_printf(stats,
+      "History compression: %" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+      " bytes saved, %u dictionaries trained\n",
+      raw_bytes - stored_bytes, raw_bytes, dictionaries);
+  g_string_append_printf(stats,
+      "Do not disturb: %u held, %" G_GSIZE_FORMAT " of %d bytes, %u evicted\n",
+      dnd_held.length, dnd_bytes, dnd_buffer_size, dnd_evicted);
+  g_string_append_printf(stats,
+      "Rules: %u active, %u evaluated, %u dropped; %.2f usec avg, %" G_GINT64_FORMAT " usec max\n",
+      rule_set_size(rule_set), rule_evaluations, rule_drops,
+      rule_evaluations ? (double) rule_usec_total / rule_evaluations : 0.0,
+      rule_usec_max);
+}
+
+// Reads the rollup table only, so it costs the same with any amount of
+// history.
+static void
+load_top_talkers(GtkListStore* const model) {
+  flush_rollups();
+  gtk_list_store_clear(model);
+  const gint now = (gint) (time(NULL) / 60);
+  const gint this_hour = now - now % ROLLUP_HOUR;
+
+  void
+  append_top_talkers(sqlite3_stmt* const stmt) {
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      list_store_set_after_append(model,
+          0, sqlite3_column_text(stmt, 0),
+          1, (guint) sqlite3_column_int(stmt, 1),
+          2, (guint) sqlite3_column_int(stmt, 2),
+          3, (guint) sqlite3_column_int(stmt, 3), -1);
+    }
+  }
+  statement_sqlite3(append_top_talkers,
+      "select app_name,"
+      " sum(case when period = %d and minute > %d then count else 0 end),"
+      " sum(case when period = %d and minute > %d then count else 0 end),"
+      " sum(case when period = %d then count else 0 end) as week"
+      " from rollup where minute > %d"
+      " group by app_name order by week desc limit 20",
+      ROLLUP_MINUTE, now - 60,
+      ROLLUP_HOUR, this_hour - 24 * 60,
+      ROLLUP_HOUR,
+      this_hour - 7 * 24 * 60);
+}
+
+static void
+top_talkers_refresh_clicked(GtkWidget* GOL_UNUSED_ARG(widget), gpointer user_data) {
+  load_top_talkers(GTK_LIST_STORE(user_data));
+}
+
+static gboolean
+refresh_statistics(gpointer user_data) {
+  GString* const stats = g_string_new(NULL);
+  append_statistics(stats);
+  gtk_label_set_text(GTK_LABEL(user_data), stats->str);
+  g_string_free(stats, TRUE);
+  return TRUE;
+}
+
+static void
+rules_apply_clicked(GtkWidget* GOL_UNUSED_ARG(widget), gpointer user_data) {
+  GtkTextBuffer* const buffer = gtk_text_view_get_buffer(
+      GTK_TEXT_VIEW(get_data_as_object(user_data, "rules")));
+  GtkLabel* const status = GTK_LABEL(get_data_as_object(user_data, "rules_status"));
+
+  GtkTextIter start, end;
+  gtk_text_buffer_get_bounds(buffer, &start, &end);
+  gchar* const text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
+
+  GError* error = NULL;
+  if (load_rules(text, &error)) {
+    set_config_string("rules", text);
+    gchar* const message = g_strdup_printf("%u rules active.", rule_set_size(rule_set));
+    gtk_label_set_text(status, message);
+    g_free(message);
+  } else {
+    // The previous rules stay in effect.
+    gtk_label_set_text(status, error->message);
+    g_error_free(error);
+  }
+  g_free(text);
+}
+
 static void
 settings_clicked(GtkWidget* GOL_UNUSED_ARG(widget), GdkEvent* GOL_UNUSED_ARG(event), gpointer GOL_UNUSED_ARG(user_data)) {
   if (setting_dialog) {
@@ -977,16 +2565,15 @@ settings_clicked(GtkWidget* GOL_UNUSED_ARG(widget), GdkEvent* GOL_UNUSED_ARG(eve
           G_CALLBACK(notification_display_changed), setting_dialog);
       gtk_box_pack_start(GTK_BOX(hbox), combobox, FALSE, FALSE, 0);
 
-      {
-        char* const sql = "select distinct app_name from application order by app_name";
-        sqlite3_stmt *stmt = NULL;
-        sqlite3_prepare(db, sql, strlen(sql), &stmt, NULL);
+      void
+      append_application_names(sqlite3_stmt* const stmt) {
         while (sqlite3_step(stmt) == SQLITE_ROW) {
           list_store_set_after_append(
               GTK_LIST_STORE(model1), 0, sqlite3_column_text(stmt, 0), -1);
         }
-        sqlite3_finalize(stmt);
       }
+      statement_sqlite3(append_application_names,
+          "select distinct app_name from application order by app_name");
 
       void
       append_display_plugins(DISPLAY_PLUGIN* dp) {
@@ -1068,52 +2655,148 @@ settings_clicked(GtkWidget* GOL_UNUSED_ARG(widget), GdkEvent* GOL_UNUSED_ARG(eve
   }
 
   {
-    GtkWidget* hbox = gtk_hbox_new(FALSE, 5);
-    gtk_container_set_border_width(GTK_CONTAINER(hbox), 10);
+    GtkWidget* vbox = gtk_vbox_new(FALSE, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(vbox), 10);
     gtk_notebook_append_page(GTK_NOTEBOOK(notebook),
-        hbox, gtk_label_new("Notifications"));
+        vbox, gtk_label_new("Notifications"));
 
-    GtkListStore* model = (GtkListStore *) gtk_list_store_new(
-        3, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
-    g_object_set_data(G_OBJECT(setting_dialog), "notifications", model);
-    GtkWidget* tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(model));
+    GtkWidget* hbox = gtk_hbox_new(FALSE, 5);
+    gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
+    GtkWidget* search = gtk_entry_new();
+    g_object_set_data(G_OBJECT(setting_dialog), "history_search", search);
+    g_signal_connect(G_OBJECT(search), "activate",
+        G_CALLBACK(history_search_activate), setting_dialog);
+    gtk_box_pack_start(GTK_BOX(hbox), search, TRUE, TRUE, 0);
+    GtkWidget* all = gtk_toggle_button_new_with_label("All");
+    g_object_set_data(G_OBJECT(setting_dialog), "history_all", all);
+    g_signal_connect(G_OBJECT(all), "toggled",
+        G_CALLBACK(history_all_toggled), setting_dialog);
+    gtk_box_pack_start(GTK_BOX(hbox), all, FALSE, FALSE, 0);
+
+    // Opens on the recent notifications, held in memory; the history
+    // itself is only read once "All" is pressed.
+    g_object_set_data_full(G_OBJECT(setting_dialog), "history_recent",
+        recent_model_new(), g_object_unref);
+    GtkWidget* tree_view = gtk_tree_view_new();
+    g_object_set_data(G_OBJECT(setting_dialog), "history_view", tree_view);
 
     GtkTreeSelection* select = gtk_tree_view_get_selection(
         GTK_TREE_VIEW(tree_view));
     gtk_tree_selection_set_mode(select, GTK_SELECTION_SINGLE);
     GtkWidget* swin = gtk_scrolled_window_new(NULL, NULL);
     gtk_container_add(GTK_CONTAINER(swin), tree_view);
-    gtk_box_pack_start(GTK_BOX(hbox), swin, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox), swin, TRUE, TRUE, 0);
 
-    gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
-        gtk_tree_view_column_new_with_attributes(
-          "Datetime", gtk_cell_renderer_text_new(), "text", 0, NULL));
-    gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
-        gtk_tree_view_column_new_with_attributes(
-          "Title", gtk_cell_renderer_text_new(), "text", 1, NULL));
-    gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
-        gtk_tree_view_column_new_with_attributes(
-          "Text", gtk_cell_renderer_text_new(), "text", 2, NULL));
+    // Fixed height mode keeps the view from measuring every row, which
+    // would read the whole table anyway.
+    void
+    append_fixed_column(const gchar* const title, const gint column, const gint width) {
+      GtkTreeViewColumn* const tree_column = gtk_tree_view_column_new_with_attributes(
+          title, gtk_cell_renderer_text_new(), "text", column, NULL);
+      gtk_tree_view_column_set_sizing(tree_column, GTK_TREE_VIEW_COLUMN_FIXED);
+      gtk_tree_view_column_set_fixed_width(tree_column, width);
+      gtk_tree_view_column_set_resizable(tree_column, TRUE);
+      gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view), tree_column);
+    }
+    append_fixed_column("Datetime", HISTORY_MODEL_RECEIVED, 140);
+    append_fixed_column("Title", HISTORY_MODEL_TITLE, 160);
+    append_fixed_column("Text", HISTORY_MODEL_TEXT, 300);
+    gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(tree_view), TRUE);
 
-    {
-      char* const sql = "select received, title, text from notification order by received desc";
-      sqlite3_stmt *stmt = NULL;
-      sqlite3_prepare(db, sql, strlen(sql), &stmt, NULL);
-      while (sqlite3_step(stmt) == SQLITE_ROW) {
-        list_store_set_after_append(
-            GTK_LIST_STORE(model),
-            0, sqlite3_column_text(stmt, 0),
-            1, sqlite3_column_text(stmt, 1),
-            2, sqlite3_column_text(stmt, 2),
-            -1);
-      }
-      sqlite3_finalize(stmt);
+    load_history(setting_dialog, NULL);
+  }
+
+  {
+    GtkWidget* vbox = gtk_vbox_new(FALSE, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(vbox), 10);
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), vbox,
+        gtk_label_new("Rules"));
+
+    GtkWidget* label = gtk_label_new(
+        "One rule per line: conditions, then => and an action.\n"
+        "Conditions: app=\"Name\" name=\"Notification\" title=/regex/i text=\"substring\" from=192.168.1.*\n"
+        "Actions: drop, display <name>, priority <-2..2>, sticky");
+    gtk_label_set_selectable(GTK_LABEL(label), TRUE);
+    GtkWidget* align = gtk_alignment_new(0, 0, 0, 0);
+    gtk_container_add(GTK_CONTAINER(align), label);
+    gtk_box_pack_start(GTK_BOX(vbox), align, FALSE, FALSE, 0);
+
+    GtkWidget* text_view = gtk_text_view_new();
+    g_object_set_data(G_OBJECT(setting_dialog), "rules", text_view);
+    gchar* const rules = get_config_string("rules", "");
+    gtk_text_buffer_set_text(
+        gtk_text_view_get_buffer(GTK_TEXT_VIEW(text_view)), rules, -1);
+    g_free(rules);
+    GtkWidget* swin = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(swin), text_view);
+    gtk_box_pack_start(GTK_BOX(vbox), swin, TRUE, TRUE, 0);
+
+    GtkWidget* hbox = gtk_hbox_new(FALSE, 5);
+    gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
+    label = gtk_label_new("");
+    g_object_set_data(G_OBJECT(setting_dialog), "rules_status", label);
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+    GtkWidget* button = gtk_button_new_with_label("Apply");
+    g_signal_connect(G_OBJECT(button), "clicked",
+        G_CALLBACK(rules_apply_clicked), setting_dialog);
+    gtk_box_pack_end(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+  }
+
+  {
+    GtkWidget* vbox = gtk_vbox_new(FALSE, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(vbox), 10);
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), vbox,
+        gtk_label_new("Top talkers"));
+
+    GtkListStore* const model = gtk_list_store_new(4,
+        G_TYPE_STRING, G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT);
+    GtkWidget* tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(model));
+    g_object_unref(model);
+    static const gchar* const titles[] = {
+      "Application", "Last hour", "Last 24 hours", "Last 7 days",
+    };
+    for (guint n = 0; n < G_N_ELEMENTS(titles); ++n) {
+      gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
+          gtk_tree_view_column_new_with_attributes(
+            titles[n], gtk_cell_renderer_text_new(), "text", n, NULL));
     }
+    GtkWidget* swin = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(swin),
+        GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(swin), tree_view);
+    gtk_box_pack_start(GTK_BOX(vbox), swin, TRUE, TRUE, 0);
+
+    GtkWidget* hbox = gtk_hbox_new(FALSE, 5);
+    gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
+    GtkWidget* button = gtk_button_new_with_label("Refresh");
+    g_signal_connect(G_OBJECT(button), "clicked",
+        G_CALLBACK(top_talkers_refresh_clicked), model);
+    gtk_box_pack_end(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+
+    load_top_talkers(model);
+  }
+
+  guint statistics_timer;
+  {
+    GtkWidget* vbox = gtk_vbox_new(FALSE, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(vbox), 10);
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), vbox,
+        gtk_label_new("Statistics"));
+
+    GtkWidget* label = gtk_label_new("");
+    gtk_label_set_selectable(GTK_LABEL(label), TRUE);
+    GtkWidget* align = gtk_alignment_new(0, 0, 0, 0);
+    gtk_container_add(GTK_CONTAINER(align), label);
+    gtk_box_pack_start(GTK_BOX(vbox), align, FALSE, FALSE, 0);
+
+    refresh_statistics(label);
+    statistics_timer = g_timeout_add(1000, refresh_statistics, label);
   }
 
   gtk_widget_set_size_request(setting_dialog, 500, 500);
   gtk_widget_show_all(setting_dialog);
   gtk_dialog_run(GTK_DIALOG(setting_dialog));
+  g_source_remove(statistics_timer);
   gtk_widget_destroy(setting_dialog);
   gtk_widget_destroy(contextmenu);
   setting_dialog = NULL;
@@ -1166,6 +2849,84 @@ exit_clicked(GtkWidget* GOL_UNUSED_ARG(widget), GdkEvent* GOL_UNUSED_ARG(event),
   gtk_main_quit();
 }
 
+static NOTIFICATION_INFO*
+copy_notification_info(const NOTIFICATION_INFO* const ni) {
+  NOTIFICATION_INFO* const copy = g_new0(NOTIFICATION_INFO, 1);
+  *copy = *ni;
+  copy->title = g_strdup(ni->title);
+  copy->text = g_strdup(ni->text);
+  copy->icon = g_strdup(ni->icon);
+  copy->url = g_strdup(ni->url);
+  copy->repeat = 0;
+  return copy;
+}
+
+static void
+missed_row_activated(GtkTreeView* tree_view, GtkTreePath* path,
+    GtkTreeViewColumn* GOL_UNUSED_ARG(column), gpointer GOL_UNUSED_ARG(user_data)) {
+  GtkTreeModel* const model = gtk_tree_view_get_model(tree_view);
+  GtkTreeIter iter;
+  if (!gtk_tree_model_get_iter(model, &iter, path)) return;
+
+  DISPLAY_REQUEST* held;
+  gtk_tree_model_get(model, &iter, 3, &held, -1);
+  // The buffer may have moved on while the dialog was open.
+  if (!g_queue_find(&dnd_held, held)) return;
+  schedule_request(display_request_new(held->dp, copy_notification_info(held->ni),
+      held->application_name, held->notification_name, held->source));
+}
+
+static void
+missed_clicked(GtkWidget* GOL_UNUSED_ARG(widget), gpointer GOL_UNUSED_ARG(user_data)) {
+  GtkWidget* const dialog = gtk_dialog_new_with_buttons(
+      "Missed Notifications", NULL, GTK_DIALOG_MODAL,
+      GTK_STOCK_CLEAR, GTK_RESPONSE_REJECT,
+      GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE, NULL);
+  gtk_window_set_position(GTK_WINDOW(dialog), GTK_WIN_POS_CENTER);
+
+  GtkListStore* const model = gtk_list_store_new(
+      4, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER);
+  for (GList* it = dnd_held.tail; it; it = it->prev) {
+    const DISPLAY_REQUEST* const held = (const DISPLAY_REQUEST*) it->data;
+    list_store_set_after_append(model,
+        0, held->application_name ? held->application_name : "",
+        1, held->ni->title,
+        2, held->ni->text,
+        3, held,
+        -1);
+  }
+
+  GtkWidget* const tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(model));
+  g_object_unref(model);
+  g_signal_connect(G_OBJECT(tree_view), "row-activated",
+      G_CALLBACK(missed_row_activated), NULL);
+  gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
+      gtk_tree_view_column_new_with_attributes(
+        "Application", gtk_cell_renderer_text_new(), "text", 0, NULL));
+  gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
+      gtk_tree_view_column_new_with_attributes(
+        "Title", gtk_cell_renderer_text_new(), "text", 1, NULL));
+  gtk_tree_view_append_column(GTK_TREE_VIEW(tree_view),
+      gtk_tree_view_column_new_with_attributes(
+        "Text", gtk_cell_renderer_text_new(), "text", 2, NULL));
+  GtkWidget* const swin = gtk_scrolled_window_new(NULL, NULL);
+  gtk_container_add(GTK_CONTAINER(swin), tree_view);
+  gtk_container_add(GTK_CONTAINER(GTK_DIALOG(dialog)->vbox), swin);
+
+  gtk_widget_set_size_request(dialog, 500, 400);
+  gtk_widget_show_all(dialog);
+  if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_REJECT)
+    dnd_clear();
+  gtk_widget_destroy(dialog);
+}
+
+static void
+append_missed_menu_item(GtkMenuShell* const menu) {
+  GtkWidget* const menu_item = gtk_menu_item_new_with_label("Missed Notifications");
+  g_signal_connect(G_OBJECT(menu_item), "activate", G_CALLBACK(missed_clicked), NULL);
+  gtk_menu_shell_append(menu, menu_item);
+}
+
 static char*
 crlf_to_term_or_null(char* str) {
   str = strstr(str, "\r\n");
@@ -1204,6 +2965,8 @@ typedef struct {
   const char* application_name;
   const char* notification_name;
   const char* notification_display_name;
+  const char* source;
+  const char* coalescing_id;
 } CLIENT_INFO;
 
 static bool
@@ -1223,48 +2986,33 @@ raise_notification(const CLIENT_INFO ci, NOTIFICATION_INFO* const ni) {
   }
   if (!valid) return false;
 
-  if (gol_status == GOL_STATUS_DND)
-    return true;
+  ROUTE route;
+  if (!lookup_route(ci.application_name, ci.notification_name, &route))
+    route.enabled = FALSE;
 
-  DISPLAY_PLUGIN* cp = NULL;
   // Received name.
-  if (ci.notification_display_name) {
-    bool
-    is_ndn(const DISPLAY_PLUGIN* dp) {
-      return !g_ascii_strcasecmp(dp->name(), ci.notification_display_name);
-    }
-    cp = find_display_plugin(is_ndn);
-  }
+  DISPLAY_PLUGIN* cp = find_display_plugin_by_name(ci.notification_display_name);
 
   // Lookup application default notification name.
-  if (!cp) {
-    sqlite3_stmt* const stmt = prepare_sqlite3(
-      "select enable, display from application"
-      " where app_name = '%q' and name = '%q'",
-      ci.application_name, ci.notification_name);
-    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0)) {
-      const char* const adn = (const char*) sqlite3_column_text(stmt, 1);
-      bool
-      is_adn(const DISPLAY_PLUGIN* dp) {
-        return !g_ascii_strcasecmp(dp->name(), adn);
-      }
-      cp = find_display_plugin(is_adn);
-    }
-    sqlite3_finalize(stmt);
-  }
+  if (!cp && route.enabled) cp = route.dp;
 
   // Lookup system default notification name.
   if (!cp) {
-    const char* const sdn = get_config_string("default_display", "Fog");
-    bool
-    is_sdn(const DISPLAY_PLUGIN* dp) {
-      return !g_ascii_strcasecmp(dp->name(), sdn);
-    }
-    cp = find_display_plugin_or(is_sdn, current_display);
+    // Looked up in place rather than copied, as this runs for most
+    // notifications; the lock keeps the value alive meanwhile.
+    G_LOCK(config_cache);
+    const gchar* const sdn = lookup_config_cache("default_display");
+    cp = find_display_plugin_by_name(sdn ? sdn : "Fog");
+    G_UNLOCK(config_cache);
+    if (!cp) cp = current_display;
   }
 
   ni->timeout = get_config_value("default_timeout", 5000)/10;
-  g_idle_add((GSourceFunc) cp->show, ni); // call once
+  DISPLAY_REQUEST* const dr = display_request_new(
+      cp, ni, ci.application_name, ci.notification_name, ci.source);
+  dr->coalescing_id = ci.coalescing_id && *ci.coalescing_id
+    ? g_strdup(ci.coalescing_id) : NULL;
+  dispatch_push(show_notification, dr, (GDestroyNotify) free_display_request);
   return true;
 }
 
@@ -1317,6 +3065,10 @@ gntp_recv_proc(gpointer user_data) {
       is_local_app = TRUE;
     }
   }
+  gchar* source = NULL;
+  client_len = sizeof(client);
+  if (!getpeername(sock, (struct sockaddr *) &client, &client_len))
+    source = g_strdup(inet_ntoa(client.sin_addr));
 
   char* ptr = "";
   const size_t r = read_all(sock, &ptr);
@@ -1437,6 +3189,18 @@ gntp_recv_proc(gpointer user_data) {
 
     ptr = data;
     if (!strcmp(command, "REGISTER")) {
+      const gint64 started = g_get_monotonic_time();
+      // Many clients re-register on every start, or before every NOTIFY.
+      gchar* fingerprint_name;
+      const guint64 fingerprint = registration_fingerprint(ptr, &fingerprint_name);
+      if (registration_unchanged(fingerprint_name, fingerprint)) {
+        ptr = GNTP_OK_STRING_LITERAL("1.0", "REGISTER");
+        send(sock, ptr, strlen(ptr), 0);
+        record_register_latency(g_get_monotonic_time() - started);
+        g_free(fingerprint_name);
+        free(data);
+        goto done;
+      }
       char* application_name = NULL;
       char* application_icon = NULL;
       long notifications_count = 0;
@@ -1461,8 +3225,12 @@ gntp_recv_proc(gpointer user_data) {
           g_free(value);
         }
       }
-      int n;
-      for (n = 0; n < notifications_count; n++) {
+      // One transaction for the whole registration.
+      // Routes only change once the rows are committed.
+      GArray* const new_routes = g_array_new(FALSE, FALSE, sizeof(NEW_ROUTE));
+      gboolean written = TRUE;
+      begin_sqlite3();
+      for (long n = 0; written && n < notifications_count; n++) {
         char* notification_name = NULL;
         char* notification_icon = NULL;
         gboolean notification_enabled = FALSE;
@@ -1496,46 +3264,58 @@ gntp_recv_proc(gpointer user_data) {
           }
         }
 
-        int exist = 0;
-        void
-        get_count(sqlite3_stmt* const stmt) {
-          exist = sqlite3_step(stmt) == SQLITE_ROW
-            ? (gboolean) sqlite3_column_int(stmt, 0)
-            : 0;
-        }
-        statement_sqlite3(get_count,
-          "select count(*) from application where app_name = '%q' and name = '%q'",
-          application_name, notification_name);
-
-        if (!exist) {
-          exec_sqlite3(
-            "delete from application where app_name = '%q' and name = '%q'",
-            application_name, notification_name);
-
-          exec_sqlite3(
-            "insert into application("
-            "app_name, app_icon, name, icon, enable, display, sticky)"
-            " values('%q', '%q', '%q', '%q', %d, '%q', %d)",
-            application_name,
-            application_icon ? application_icon : "",
-            notification_name,
-            notification_icon ? notification_icon : "",
-            notification_enabled,
-            notification_display_name ?
-              notification_display_name : "Fog",
-            notification_sticky);
-        }
+        // Known notifications only pick up new icons; enable, display and
+        // sticky may have been changed by the user since. Two steps rather
+        // than an upsert, which older SQLite doesn't have.
+        const char* const display = notification_display_name ?
+          notification_display_name : "Fog";
+        written = exec_sqlite3(
+          "insert or ignore into application("
+          "app_name, app_icon, name, icon, enable, display, sticky)"
+          " values('%q', '%q', '%q', '%q', %d, '%q', %d)",
+          application_name,
+          application_icon ? application_icon : "",
+          notification_name,
+          notification_icon ? notification_icon : "",
+          notification_enabled,
+          display,
+          notification_sticky) && exec_sqlite3(
+          "update application set app_icon = '%q', icon = '%q'"
+          " where app_name = '%q' and name = '%q'",
+          application_icon ? application_icon : "",
+          notification_icon ? notification_icon : "",
+          application_name,
+          notification_name);
+        const NEW_ROUTE route = {
+          g_strdup(notification_name), g_strdup(display), notification_enabled,
+        };
+        g_array_append_val(new_routes, route);
 
         g_free(notification_name);
         g_free(notification_icon);
         g_free(notification_display_name);
       }
-      parse_identifiers(ptr);
+      // One bad notification fails the whole REGISTER.
+      gboolean registered = FALSE;
+      if (written) registered = commit_sqlite3();
+      else rollback_sqlite3();
+      for (guint r = 0; r < new_routes->len; r++) {
+        NEW_ROUTE* const route = &g_array_index(new_routes, NEW_ROUTE, r);
+        if (registered)
+          add_route(application_name, route->name, route->enabled, route->display);
+        g_free(route->name);
+        g_free(route->display);
+      }
+      g_array_free(new_routes, TRUE);
+      if (registered) parse_identifiers(ptr);
 
-      ptr = n == notifications_count
+      ptr = registered
         ? GNTP_OK_STRING_LITERAL("1.0", "REGISTER")
         : GNTP_ERROR_STRING_LITERAL("1.0", "Invalid data", "Invalid data");
       send(sock, ptr, strlen(ptr), 0);
+      if (registered) remember_registration(fingerprint_name, fingerprint);
+      record_register_latency(g_get_monotonic_time() - started);
+      g_free(fingerprint_name);
       g_free(application_name);
       g_free(application_icon);
     } else {
@@ -1547,6 +3327,7 @@ gntp_recv_proc(gpointer user_data) {
       char* application_name = NULL;
       char* notification_name = NULL;
       char* notification_display_name = NULL;
+      char* coalescing_id = NULL;
       while (*ptr) {
         char* const line = ptr;
         ptr = crlf_to_term_and_skip(ptr);
@@ -1574,43 +3355,35 @@ gntp_recv_proc(gpointer user_data) {
           else if (!strncmp(line, "Notification-Sticky:", 20)) {
             ni->sticky = strcasecmp(value, "true") == 0;
           }
+          else if (!strncmp(line, "Notification-Priority:", 22)) {
+            ni->priority = CLAMP(atoi(value), PRIORITY_MIN, PRIORITY_MAX);
+          }
           else if (!strncmp(line, "Notification-Callback-Target:", 29)) {
             str_swap(&value, &ni->url);
           }
           else if (!strncmp(line, "Notification-Display-Name:", 26)) {
             str_swap(&value, &notification_display_name);
           }
+          else if (!strncmp(line, "Notification-Coalescing-ID:", 27)) {
+            str_swap(&value, &coalescing_id);
+          }
           g_free(value);
         }
       }
       parse_identifiers(ptr);
 
-      exec_sqlite3(
-        "insert into notification("
-        "title, text, icon, url, received)"
-        " values('%q', '%q', '%q', '%q', current_timestamp)",
-        ni->title, ni->text,
-        ni->icon ? ni->icon : "",
-        ni->url ? ni->url : "");
-      if (setting_dialog) {
-        GtkTreeModel* const model
-          = (GtkTreeModel*) get_data_as_object(setting_dialog, "notifications");
-        gchar* value;
-        void
-        get_current_timestamp(sqlite3_stmt* const stmt) {
-          value = g_strdup(
-              sqlite3_step(stmt) == SQLITE_ROW
-                ? (char*) sqlite3_column_text(stmt, 0)
-                : "");
-        }
-        statement_sqlite3(get_current_timestamp, "select current_timestamp");
-        list_store_set_before_prepand(GTK_LIST_STORE(model),
-            0, value,
-            1, ni->title,
-            2, ni->text,
-            -1);
-        g_free(value);
-      }
+      gchar* const received = current_timestamp();
+      const gint64 serial = history_append(application_name, notification_name,
+          ni->title, ni->text, ni->icon, ni->url, received);
+      rollup_count(application_name, notification_name, time(NULL));
+      // The settings dialog belongs to the GTK thread.
+      HISTORY_ROW* const row = g_new(HISTORY_ROW, 1);
+      row->serial = serial;
+      row->received = received;
+      row->application_name = g_strdup(application_name);
+      row->title = g_strdup(ni->title);
+      row->text = g_strdup(ni->text);
+      dispatch_push(prepend_history_row, row, free_history_row);
 
       raise_notification(
         (CLIENT_INFO){
@@ -1619,8 +3392,11 @@ gntp_recv_proc(gpointer user_data) {
           .application_name          = application_name,
           .notification_name         = notification_name,
           .notification_display_name = notification_display_name,
+          .source                    = source,
+          .coalescing_id             = coalescing_id,
         }, ni);
 
+      g_free(coalescing_id);
       g_free(notification_name);
       g_free(notification_display_name);
       g_free(application_name);
@@ -1630,7 +3406,9 @@ gntp_recv_proc(gpointer user_data) {
     ptr = GNTP_ERROR_STRING_LITERAL("1.0", "Invalid command", "Invalid command");
     send(sock, ptr, strlen(ptr), 0);
   }
+done:
   free(top);
+  g_free(source);
   shutdown(sock, SD_BOTH);
   closesocket(sock);
   return NULL;
@@ -1639,6 +3417,7 @@ leave:
   ptr = GNTP_ERROR_STRING_LITERAL("1.0", "Invalid request", "Invalid request");
   send(sock, ptr, strlen(ptr), 0);
   free(top);
+  g_free(source);
   shutdown(sock, SD_BOTH);
   closesocket(sock);
   return NULL;
@@ -1701,11 +3480,13 @@ gol_status_toggle(GtkMenuItem* menu_item, gpointer GOL_UNUSED_ARG(user_data)) {
   {
     case GOL_STATUS_NORMAL:
       gol_status = GOL_STATUS_DND;
+      dnd_enter();
       app_indicator_set_status(indicator, APP_INDICATOR_STATUS_ACTIVE);
       gtk_menu_item_set_label(menu_item, "Switch to on");
       break;
     case GOL_STATUS_DND:
       gol_status = GOL_STATUS_NORMAL;
+      dnd_leave();
       app_indicator_set_status(indicator, APP_INDICATOR_STATUS_ATTENTION);
       gtk_menu_item_set_label(menu_item, "Switch to off");
       break;
@@ -1725,6 +3506,8 @@ create_menu() {
   popup_menu = gtk_menu_new();
   menu_item = gtk_menu_item_new_with_label("Switch to off");
   gtk_menu_shell_append(GTK_MENU_SHELL(popup_menu), menu_item);
+  append_missed_menu_item(GTK_MENU_SHELL(popup_menu));
+  append_recent_menu_item(GTK_MENU_SHELL(popup_menu));
   gtk_menu_shell_append(GTK_MENU_SHELL(popup_menu),
     gtk_separator_menu_item_new());
   append_new_menu_item_from_stock(GTK_MENU_SHELL(popup_menu),
@@ -1752,10 +3535,12 @@ gol_status_toggle(GtkStatusIcon* status_icon, GdkEvent* event, gpointer user_dat
   {
     case GOL_STATUS_NORMAL:
       gol_status = GOL_STATUS_DND;
+      dnd_enter();
       gtk_status_icon_set_from_pixbuf(status_icon, status_icon_dnd_pixbuf);
       break;
     case GOL_STATUS_DND:
       gol_status = GOL_STATUS_NORMAL;
+      dnd_leave();
       gtk_status_icon_set_from_pixbuf(status_icon, status_icon_pixbuf);
       break;
   }
@@ -1801,6 +3586,10 @@ create_menu() {
   g_signal_connect(G_OBJECT(status_icon), "button-release-event",
       G_CALLBACK(gol_status_toggle), 0);
 
+  append_missed_menu_item(GTK_MENU_SHELL(popup_menu));
+  append_recent_menu_item(GTK_MENU_SHELL(popup_menu));
+  gtk_menu_shell_append(GTK_MENU_SHELL(popup_menu),
+    gtk_separator_menu_item_new());
   append_new_menu_item_from_stock(GTK_MENU_SHELL(popup_menu),
     GTK_STOCK_PREFERENCES, G_CALLBACK(settings_clicked));
   append_new_menu_item_from_stock(GTK_MENU_SHELL(popup_menu),
@@ -1817,6 +3606,9 @@ create_menu() {
 
 static void
 destroy_menu() {
+  if (recent_menu_refresh) g_source_remove(recent_menu_refresh);
+  recent_menu_refresh = 0;
+  recent_menu = NULL;
   if (popup_menu) {
       gtk_widget_destroy(popup_menu);
   }
@@ -1834,6 +3626,139 @@ destroy_menu() {
   }
 }
 
+static const char* const migration_sqls[] = {
+  "drop table _notification",
+  "drop table _application",
+  "drop table _subscriber",
+  "drop table _display",
+  "alter table application rename to _application",
+  "alter table subscriber rename to _subscriber",
+  "alter table display rename to _display",
+  "create table notification("
+      "title text not null,"
+      "text text not null,"
+      "icon text,"
+      "url text,"
+      "received timestamp not null)",
+  "create table application("
+      "app_name text not null,"
+      "app_icon text not null,"
+      "name text not null,"
+      "icon text not null,"
+      "enable int not null,"
+      "display text not null,"
+      "sticky int not null,"
+      "primary key(app_name, name))",
+  "create table subscriber("
+      "name text not null primary key,"
+      "enable int not null)",
+  "create table display("
+      "name text not null primary key,"
+      "parameter text)",
+  "insert into notification from select * from _notification",
+  "insert into application from select * from _application",
+  "insert into subscriber from select * from _subscriber",
+  "insert into display from select * from _display",
+  "drop table _notification",
+  "drop table _application",
+  "drop table _subscriber",
+  "drop table _display",
+  NULL
+};
+
+typedef struct {
+  gchar* confdb;
+  gboolean committed;
+} MIGRATION_RESULT;
+
+static void
+free_migration_result(gpointer data) {
+  MIGRATION_RESULT* const result = (MIGRATION_RESULT*) data;
+  g_free(result->confdb);
+  g_free(result);
+}
+
+// On failure everything was rolled back, so the old version stays and
+// the history, which may need the new tables, is left closed.
+static void
+migration_done(gpointer data) {
+  MIGRATION_RESULT* const result = (MIGRATION_RESULT*) data;
+  if (result->committed) {
+    cache_config_string("version", PACKAGE_VERSION);
+    load_routes();
+    g_message("Database migrated in %.1f ms", migration_usec / 1000.0);
+    history_open(result->confdb);
+    g_idle_add(seed_recent, NULL);
+  }
+  free_migration_result(result);
+}
+
+// Runs the migration on its own connection, in one transaction, while
+// the listeners are already up. Other connections wait on the busy
+// timeout for the few statements that touch the same tables.
+static gpointer
+migrate_proc(gpointer data) {
+  const gint64 started = g_get_monotonic_time();
+  MIGRATION_RESULT* const result = g_new0(MIGRATION_RESULT, 1);
+  result->confdb = (gchar*) data;
+  sqlite3* mdb = NULL;
+  if (sqlite3_open((const gchar*) data, &mdb) == SQLITE_OK) {
+    sqlite3_busy_timeout(mdb, 5000);
+    sqlite3_exec(mdb, "begin immediate", NULL, NULL, NULL);
+    for (gint n = 0; migration_sqls[n]; ++n) {
+      sqlite3_exec(mdb, migration_sqls[n], NULL, NULL, NULL);
+      g_atomic_int_set(&migration_step, n + 1);
+    }
+    char* const sql = sqlite3_mprintf(
+        "insert or replace into config(key, value) values('version', %Q)", PACKAGE_VERSION);
+    sqlite3_exec(mdb, sql, NULL, NULL, NULL);
+    sqlite3_free(sql);
+    result->committed = sqlite3_exec(mdb, "commit", NULL, NULL, NULL) == SQLITE_OK;
+    if (!result->committed) {
+      g_critical("Can't migrate database: %s", sqlite3_errmsg(mdb));
+      sqlite3_exec(mdb, "rollback", NULL, NULL, NULL);
+    }
+  } else {
+    g_critical("Can't open database: %s", (const gchar*) data);
+  }
+  sqlite3_close(mdb);
+  migration_usec = g_get_monotonic_time() - started;
+  dispatch_push(migration_done, result, free_migration_result);
+  return NULL;
+}
+
+static void
+start_migration(gchar* const confdb) {
+  migration_steps = G_N_ELEMENTS(migration_sqls) - 1;
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+  migration_thread = g_thread_create(migrate_proc, confdb, TRUE, NULL);
+#else
+  migration_thread = g_thread_try_new("migration", migrate_proc, confdb, NULL);
+#endif
+  if (!migration_thread) {
+    g_critical("Can't start migration");
+    g_free(confdb);
+  }
+}
+
+static void
+finish_migration() {
+  if (migration_thread) g_thread_join(migration_thread);
+  migration_thread = NULL;
+}
+
+static gchar*
+get_config_db_path() {
+  const gchar* const confdir = (const gchar*) g_get_user_config_dir();
+  return g_build_filename(confdir, "gol", "config.db", NULL);
+}
+
+static gchar*
+get_history_log_path() {
+  const gchar* const confdir = (const gchar*) g_get_user_config_dir();
+  return g_build_filename(confdir, "gol", "history", NULL);
+}
+
 static gboolean
 load_config() {
   const gchar* const confdir = (const gchar*) g_get_user_config_dir();
@@ -1844,71 +3769,38 @@ load_config() {
     g_free(appdir);
     return FALSE;
   }
-  gchar* const confdb = g_build_filename(appdir, "config.db", NULL);
   g_free(appdir);
+  gchar* const confdb = get_config_db_path();
   const gboolean exist = g_file_test(confdb, G_FILE_TEST_EXISTS);
   if (sqlite3_open(confdb, &db) != SQLITE_OK) {
     g_critical("Can't open database: %s", confdb);
     g_free(confdb);
     return FALSE;
   }
-  g_free(confdb);
+  // The history writer holds the write lock while it commits a batch.
+  sqlite3_busy_timeout(db, 5000);
+  // Lets the readers below go on while something is being written.
+  sqlite3_exec(db, "pragma journal_mode=wal", NULL, NULL, NULL);
+  // Queries fall back to this connection when there are no readers.
+  history_codec_register(db);
+  stmt_cache = stmt_cache_new(db);
 
   if (!exist) {
     if (sqlite3_exec(db, "create table config"
           "(key text not null primary key, value text not null)",
           NULL, NULL, NULL) != SQLITE_OK) {
       g_critical("Can't create configuration table");
+      g_free(confdb);
       return FALSE;
     }
   }
+  load_config_cache();
+  // Not fatal: without readers, queries share the writer's connection.
+  readers = db_pool_new(confdb, get_config_value("read_connections", 3),
+      history_codec_register);
 
   gchar* const version = get_config_string("version", "");
-  if (strcmp(version, PACKAGE_VERSION)) {
-    const char* sqls[] = {
-      "drop table _notification",
-      "drop table _application",
-      "drop table _subscriber",
-      "drop table _display",
-      "alter table application rename to _application",
-      "alter table subscriber rename to _subscriber",
-      "alter table display rename to _display",
-      "create table notification("
-          "title text not null,"
-          "text text not null,"
-          "icon text,"
-          "url text,"
-          "received timestamp not null)",
-      "create table application("
-          "app_name text not null,"
-          "app_icon text not null,"
-          "name text not null,"
-          "icon text not null,"
-          "enable int not null,"
-          "display text not null,"
-          "sticky int not null,"
-          "primary key(app_name, name))",
-      "create table subscriber("
-          "name text not null primary key,"
-          "enable int not null)",
-      "create table display("
-          "name text not null primary key,"
-          "parameter text)",
-      "insert into notification from select * from _notification",
-      "insert into application from select * from _application",
-      "insert into subscriber from select * from _subscriber",
-      "insert into display from select * from _display",
-      "drop table _notification",
-      "drop table _application",
-      "drop table _subscriber",
-      "drop table _display",
-      NULL
-    };
-    for (const char* const* sql = sqls; *sql; ++sql) {
-      sqlite3_exec(db, *sql, NULL, NULL, NULL);
-    }
-    set_config_string("version", PACKAGE_VERSION);
-  }
+  const gboolean migrate = strcmp(version, PACKAGE_VERSION) != 0;
   g_free(version);
 
   password = get_config_string("password", "");
@@ -1916,13 +3808,80 @@ load_config() {
     get_config_bool("require_password_for_local_apps", FALSE);
   require_password_for_lan_apps =
     get_config_bool("require_password_for_lan_apps", FALSE);
+  // Negative window disables coalescing.
+  coalesce_window = get_config_value("coalesce_window", 10000);
+  coalesce_burst = get_config_value("coalesce_burst", 3);
+  // Negative means no limit on popups per display.
+  max_visible = get_config_value("max_visible", 10);
+  // Requests waiting for a free slot, per display; negative means unbounded.
+  overflow_limit = get_config_value("overflow_limit", 100);
+  // Identical notifications within dedupe_ttl msec show once; negative disables.
+  dedupe_ttl = get_config_value("dedupe_ttl", 60000);
+  dedupe_slots = (guint) MAX(get_config_value("dedupe_slots", 4096), 0);
+  // Memory held for notifications arriving in do-not-disturb mode;
+  // negative means unbounded.
+  dnd_buffer_size = get_config_value("dnd_buffer_size", 1024 * 1024);
+  // Notifications kept in memory for the tray menu and the history tab.
+  recent_size = MAX(get_config_value("recent_size", 200), 1);
+  recent = recent_new((guint) recent_size);
+  // Decoded icons kept for display plugins; negative turns the cache off.
+  icon_cache_init(get_config_value("icon_cache_bytes", 4 * 1024 * 1024));
+
+  // History is trimmed in the background, oldest first, past whichever
+  // limits are set; none are by default.
+  history_set_retention(
+      get_config_value("history_max_age", 0),
+      get_config_value("history_max_rows", 0),
+      get_config_value("history_max_bytes", 0));
+  // With a positive level, title and text are stored zstd-compressed, with
+  // a dictionary trained from recent rows and retrained every
+  // history_dict_rows rows. Off by default: tools without history_text(),
+  // the sqlite3 shell among them, can't read such rows.
+  history_set_compression(
+      get_config_value("history_compression_level", 0),
+      get_config_value("history_dict_rows", 10000));
+  // Received notifications are written in batches by a thread of their own:
+  // at most history_batch_rows per commit, at most history_flush_interval
+  // milliseconds after the first of them arrived.
+  history_init(
+      get_config_value("history_flush_interval", 200),
+      get_config_value("history_batch_rows", 256));
+  // "log" keeps history in append-only files next to the database, which
+  // is cheaper per row; "sqlite" (the default) in the notification table.
+  gchar* const backend = get_config_string("history_backend", "sqlite");
+  if (!strcmp(backend, "log")) {
+    history_log_dir = get_history_log_path();
+    history_use_log(history_log_dir);
+  }
+  g_free(backend);
 
+  // Only the config table is needed to start listening. Rows received
+  // meanwhile queue up until the history tables are ready; without them
+  // notifications are still shown, just not recorded.
+  if (migrate) {
+    start_migration(confdb);
+  } else {
+    history_open(confdb);
+    g_free(confdb);
+  }
   return TRUE;
 }
 
 static void
 unload_config() {
   g_free(password);
+  unload_config_cache();
+  db_pool_free(readers);
+  readers = NULL;
+  g_free(history_log_dir);
+  history_log_dir = NULL;
+  recent_free(recent);
+  recent = NULL;
+  HISTORY_ROW* row;
+  while ((row = (HISTORY_ROW*) g_queue_pop_head(&uncommitted))) free_history_row(row);
+  icon_cache_term();
+  stmt_cache_free(stmt_cache);
+  stmt_cache = NULL;
   if (db) sqlite3_close(db);
 }
 
@@ -1932,6 +3891,14 @@ unload_display_plugins() {
   close_plugin(DISPLAY_PLUGIN* dp) {
     if (dp->term) dp->term();
     g_module_close(dp->handle);
+    for (gint level = 0; level < PRIORITY_LEVELS; ++level) {
+      DISPLAY_REQUEST* dr;
+      while ((dr = (DISPLAY_REQUEST*) g_queue_pop_head(&dp->waiting[level])))
+        free_display_request(dr);
+    }
+    for (GList* it = dp->visible; it; it = it->next)
+      free_visible_popup((VISIBLE_POPUP*) it->data);
+    g_list_free(dp->visible);
     g_free(dp);
   }
   foreach_display_plugin(close_plugin);
@@ -1979,8 +3946,13 @@ load_display_plugins() {
     g_module_symbol(handle, "display_thumbnail", (void**) &dp->thumbnail);
     g_module_symbol(handle, "display_set_param", (void**) &dp->set_param);
     g_module_symbol(handle, "display_get_param", (void**) &dp->get_param);
+    g_module_symbol(handle, "display_expire", (void**) &dp->expire);
+    g_module_symbol(handle, "display_capacity", (void**) &dp->capacity);
+    g_module_symbol(handle, "display_refresh", (void**) &dp->refresh);
+    for (gint level = 0; level < PRIORITY_LEVELS; ++level)
+      g_queue_init(&dp->waiting[level]);
     const char* const name = dp->name ? dp->name() : NULL;
-    if (name && dp->init && !dp->init()) {
+    if (name && dp->init && !dp->init(&dc)) {
       g_module_close(dp->handle);
       g_free(dp);
       continue;
@@ -2020,7 +3992,7 @@ load_display_plugins() {
 static void
 subscribe_show(NOTIFICATION_INFO* const ni) {
   ni->timeout = get_config_value("default_timeout", 5000)/10;
-  g_idle_add((GSourceFunc) current_display->show, ni);
+  push_notification(NULL, ni, NULL, NULL, NULL);
 }
 
 static void
@@ -2099,6 +4071,7 @@ gntp_accepted(GIOChannel* const source, GIOCondition GOL_UNUSED_ARG(condition),
     perror("accept");
     return TRUE;
   }
+  if (!first_request_at) first_request_at = g_get_monotonic_time();
 
 #ifdef G_THREADS_ENABLED
 # if !GLIB_CHECK_VERSION(2, 32, 0)
@@ -2146,7 +4119,11 @@ udp_recv_proc(GIOChannel* const source, GIOCondition GOL_UNUSED_ARG(condition),
       is_local_app = TRUE;
     }
   }
-  const ssize_t len = recvfrom(fd, buf, sizeof(buf), 0, NULL, NULL);
+  struct sockaddr_in sender;
+  socklen_t sender_len = sizeof(sender);
+  memset(&sender, 0, sizeof(sender));
+  const ssize_t len = recvfrom(fd, buf, sizeof(buf), 0,
+      (struct sockaddr *) &sender, &sender_len);
   if (len > 0) {
     if (buf[0] == 1) {
       if (buf[1] == 0 || buf[1] == 2 || buf[1] == 4) {
@@ -2154,6 +4131,18 @@ udp_recv_proc(GIOChannel* const source, GIOCondition GOL_UNUSED_ARG(condition),
       } else
       if (buf[1] == 1 || buf[1] == 3 || buf[1] == 5) {
         GROWL_NOTIFY_PACKET* packet = (GROWL_NOTIFY_PACKET*) &buf[0];
+        // Every length comes from the sender; the fields and the digest
+        // after them must all be within what was received.
+        if ((size_t) len < sizeof(GROWL_NOTIFY_PACKET)) goto leave;
+        const size_t digest_length =
+          packet->type == 1 ? MD5_DIGEST_LENGTH :
+          packet->type == 3 ? SHA256_DIGEST_LENGTH : 0;
+        if ((size_t) len < sizeof(GROWL_NOTIFY_PACKET)
+            + ntohs(packet->notification_length)
+            + ntohs(packet->title_length)
+            + ntohs(packet->description_length)
+            + ntohs(packet->app_name_length)
+            + digest_length) goto leave;
 #define HASH_DIGEST_CHECK(_hash_algorithm, _password, _data, _datalen) \
 { \
   unsigned char digest[GOL_PP_CAT(_hash_algorithm, _DIGEST_LENGTH)] = {0}; \
@@ -2189,7 +4178,25 @@ udp_recv_proc(GIOChannel* const source, GIOCondition GOL_UNUSED_ARG(condition),
                   ntohs(packet->description_length));
         ni->local = TRUE;
         ni->timeout = get_config_value("default_timeout", 5000)/10;
-        g_idle_add((GSourceFunc) current_display->show, ni); // call once
+        // Bit 0 is sticky, bits 1-3 are the priority as a signed 3-bit value.
+        const unsigned short flags = ntohs(packet->flags);
+        const gint priority = (flags >> 1) & 0x07;
+        ni->sticky = flags & 0x01;
+        ni->priority = CLAMP(priority & 0x04 ? priority - 8 : priority,
+            PRIORITY_MIN, PRIORITY_MAX);
+        gchar* const notification_name = g_strndup(
+            &buf[sizeof(GROWL_NOTIFY_PACKET)],
+                  ntohs(packet->notification_length));
+        gchar* const application_name = g_strndup(
+            &buf[sizeof(GROWL_NOTIFY_PACKET)
+              + ntohs(packet->notification_length)
+              + ntohs(packet->title_length)
+              + ntohs(packet->description_length)],
+                  ntohs(packet->app_name_length));
+        push_notification(NULL, ni, application_name, notification_name,
+            inet_ntoa(sender.sin_addr));
+        g_free(notification_name);
+        g_free(application_name);
       }
     }
   }
@@ -2295,23 +4302,148 @@ destroy_udp_server(GIOChannel* const channel) {
 static void
 usage(void) {
   fprintf(stderr,"Usage: gol [option]\n");
-  fprintf(stderr," -h    : show this help\n");
+  fprintf(stderr," -h, --help           : show this help\n");
+  fprintf(stderr," -s, --search=QUERY   : print notifications matching QUERY and exit\n");
+  fprintf(stderr," -x, --export-history[=FORMAT]\n");
+  fprintf(stderr,"                      : print the history as jsonl (default) or csv and exit\n");
+  fprintf(stderr,"     --since=TIME     : export from TIME on (YYYY-MM-DD[ HH:MM[:SS]], UTC)\n");
+  fprintf(stderr,"     --until=TIME     : export up to, but not including, TIME\n");
+  fprintf(stderr,"     --app=NAME       : export only what application NAME sent\n");
   exit(1);
 }
 
+// Read from the table itself; outside the GUI the config cache isn't loaded.
+static gboolean
+history_log_configured(sqlite3* const conf) {
+  sqlite3_stmt* stmt;
+  gboolean configured = FALSE;
+  if (sqlite3_prepare_v2(conf,
+        "select value from config where key = 'history_backend'",
+        -1, &stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+      configured = !g_strcmp0((const char*) sqlite3_column_text(stmt, 0), "log");
+    sqlite3_finalize(stmt);
+  }
+  return configured;
+}
+
+// Prints matches as they are found, one tab separated line each, without
+// starting the GUI. Only reads the database, so it works next to a
+// running instance.
+static int
+search_history(const char* const query) {
+  gchar* const confdb = get_config_db_path();
+  sqlite3* search_db = NULL;
+  if (sqlite3_open_v2(confdb, &search_db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+    fprintf(stderr, "Can't open database: %s\n", confdb);
+    sqlite3_close(search_db);
+    g_free(confdb);
+    return 1;
+  }
+  g_free(confdb);
+  sqlite3_busy_timeout(search_db, 5000);
+  history_codec_register(search_db);
+
+  void
+  print_result(const gchar* received, const gchar* application_name,
+      const gchar* title, const gchar* text, gpointer GOL_UNUSED_ARG(user_data)) {
+    printf("%s\t%s\t%s\t%s\n", received,
+        application_name ? application_name : "", title, text);
+  }
+  gboolean ok;
+  if (history_log_configured(search_db)) {
+    gchar* const dir = get_history_log_path();
+    HISTORY_LOG* const log = history_log_open(dir, FALSE);
+    ok = history_log_search(log, query, 0, print_result, NULL);
+    history_log_close(log);
+    g_free(dir);
+  } else {
+    ok = history_search(search_db, query, 0, print_result, NULL);
+  }
+  sqlite3_close(search_db);
+  return ok ? 0 : 1;
+}
+
+// Streams rows to stdout as they are read; memory use stays flat however
+// long the history is.
+static int
+export_history(const HISTORY_EXPORT* const export) {
+  gchar* const confdb = get_config_db_path();
+  sqlite3* export_db = NULL;
+  if (sqlite3_open_v2(confdb, &export_db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+    fprintf(stderr, "Can't open database: %s\n", confdb);
+    sqlite3_close(export_db);
+    g_free(confdb);
+    return 1;
+  }
+  g_free(confdb);
+  sqlite3_busy_timeout(export_db, 5000);
+  history_codec_register(export_db);
+
+  static char buffer[64 * 1024];
+  setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+  gboolean ok;
+  if (history_log_configured(export_db)) {
+    gchar* const dir = get_history_log_path();
+    HISTORY_LOG* const log = history_log_open(dir, FALSE);
+    ok = history_export_log(log, export, stdout);
+    history_log_close(log);
+    g_free(dir);
+  } else {
+    ok = history_export_db(export_db, export, stdout);
+  }
+  sqlite3_close(export_db);
+  return fflush(stdout) == 0 && ok ? 0 : 1;
+}
+
 int
 main(int argc, char* argv[]) {
+  startup_at = g_get_monotonic_time();
   int ch;
 
   gchar* program = g_find_program_in_path(argv[0]);
   exepath = g_path_get_dirname(program);
   g_free(program);
 
-  while ((ch = getopt(argc, argv, "h")) != -1) {
+  static const struct option long_options[] = {
+    { "help",           no_argument,       NULL, 'h' },
+    { "search",         required_argument, NULL, 's' },
+    { "export-history", optional_argument, NULL, 'x' },
+    { "since",          required_argument, NULL, 'S' },
+    { "until",          required_argument, NULL, 'U' },
+    { "app",            required_argument, NULL, 'A' },
+    { NULL,             0,                 NULL, 0   },
+  };
+  const char* search = NULL;
+  gboolean export = FALSE;
+  HISTORY_EXPORT export_options;
+  history_export_init(&export_options);
+  while ((ch = getopt_long(argc, argv, "hs:x::", long_options, NULL)) != -1) {
     switch (ch){
     case 'h':
       usage();
       break;
+    case 's':
+      search = optarg;
+      break;
+    case 'x':
+      export = TRUE;
+      if (!optarg || !strcmp(optarg, "jsonl"))
+        export_options.format = HISTORY_EXPORT_JSON_LINES;
+      else if (!strcmp(optarg, "csv"))
+        export_options.format = HISTORY_EXPORT_CSV;
+      else
+        usage();
+      break;
+    case 'S':
+      if (!history_export_parse_time(optarg, &export_options.since)) usage();
+      break;
+    case 'U':
+      if (!history_export_parse_time(optarg, &export_options.until)) usage();
+      break;
+    case 'A':
+      export_options.application_name = optarg;
+      break;
     default:
       usage();
     }
@@ -2319,12 +4451,24 @@ main(int argc, char* argv[]) {
   argc -= optind;
   argv += optind;
 
+  if (search) {
+    const int status = search_history(search);
+    g_free(exepath);
+    return status;
+  }
+  if (export) {
+    const int status = export_history(&export_options);
+    g_free(exepath);
+    return status;
+  }
+
 #ifdef _WIN32
   WSADATA wsaData;
   WSAStartup(MAKEWORD(2, 2), &wsaData);
 #endif
   GIOChannel* gntp_io = NULL;
   GIOChannel* udp_io = NULL;
+  guint rollup_timer = 0;
 
 #ifdef G_THREADS_ENABLED
 #if !GLIB_CHECK_VERSION(2,23,2)
@@ -2343,21 +4487,49 @@ main(int argc, char* argv[]) {
   signal(SIGINT, signal_handler);
 #endif
 
+  if (!dispatch_init(10)) goto leave;
   if (!load_config()) goto leave;
+  rollup_init();
+  rollup_timer = g_timeout_add_seconds(60, flush_rollups_timer, NULL);
   if ((gntp_io = create_gntp_server()) == NULL) goto leave;
   if ((udp_io = create_udp_server()) == NULL) goto leave;
+  listening_at = g_get_monotonic_time();
   if (!load_display_plugins()) goto leave;
+  load_routes();
+  {
+    gchar* const rules = get_config_string("rules", "");
+    GError* error = NULL;
+    if (!load_rules(rules, &error)) {
+      g_warning("rules: %s", error->message);
+      g_error_free(error);
+    }
+    g_free(rules);
+  }
   if (!load_subscribe_plugins()) goto leave;
   create_menu();
+  g_idle_add(seed_recent, NULL);
 
   gtk_main();
 
 leave:
   destroy_menu();
   unload_subscribe_plugins();
+  unload_coalesce_buckets();
+  unload_routes();
+  unload_registrations();
   unload_display_plugins();
+  unload_dedupe_table();
+  unload_rules();
+  unload_coalescing_ids();
+  unload_dnd_buffer();
   destroy_gntp_server(gntp_io);
   destroy_udp_server(udp_io);
+  finish_migration();
+  dispatch_term();
+  history_term();
+  if (rollup_timer) g_source_remove(rollup_timer);
+  flush_rollups();
+  rollup_term();
   unload_config();
   g_free(exepath);
 
@@ -1,6 +1,8 @@
 #ifndef _gol_h_
 #define _gol_h_
 
+#include <string.h>
+
 #include <glib.h>
 
 #define GOL_PP_CAT_IMPL_(x, y) x ## y
@@ -44,12 +46,23 @@ typedef struct {
   gboolean sticky;
   gboolean local;
   gint timeout;
+  gint priority;
+  gint repeat;
 } NOTIFICATION_INFO;
 
 typedef struct {
   void (*show)(NOTIFICATION_INFO* ni);
 } SUBSCRIPTOR_CONTEXT;
 
+typedef struct {
+  // Display plugins call this once the popup for ni is gone, before freeing it.
+  void (*closed)(const NOTIFICATION_INFO* ni);
+  // New reference to the icon at `url` scaled to `size` pixels square (as
+  // is if not positive), or NULL. Comes from a cache shared by all
+  // displays, so the same icon is only loaded once.
+  struct _GdkPixbuf* (*icon)(const gchar* url, gboolean local, gint size);
+} DISPLAY_CONTEXT;
+
 GOL_INLINE void
 free_notification_info(NOTIFICATION_INFO* const ni) {
   if (!ni) return;
@@ -60,6 +73,33 @@ free_notification_info(NOTIFICATION_INFO* const ni) {
   g_free(ni);
 }
 
+// Title as it should be rendered, e.g. "Build failed \xc3\x9712" for repeats.
+GOL_INLINE gchar*
+notification_info_title(const NOTIFICATION_INFO* const ni) {
+  return ni->repeat > 1
+    ? g_strdup_printf("%s \xc3\x97%d", ni->title, ni->repeat)
+    : g_strdup(ni->title);
+}
+
+// 64-bit FNV-1a.
+#define GOL_HASH64_INIT G_GUINT64_CONSTANT(0xcbf29ce484222325)
+
+GOL_INLINE guint64
+gol_hash64(guint64 hash, const void* const data, const gsize len) {
+  const guchar* const bytes = (const guchar*) data;
+  for (gsize n = 0; n < len; ++n) {
+    hash ^= bytes[n];
+    hash *= G_GUINT64_CONSTANT(0x100000001b3);
+  }
+  return hash;
+}
+
+// Includes the terminator, so ("ab", "c") and ("a", "bc") differ.
+GOL_INLINE guint64
+gol_hash64_string(const guint64 hash, const gchar* const str) {
+  return str ? gol_hash64(hash, str, strlen(str) + 1) : gol_hash64(hash, "", 1);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,639 @@
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "gol.h"
+#include "history.h"
+#include "history_codec.h"
+#include "history_log.h"
+
+// Retention work is done in steps this small, so a step never holds the
+// write lock for long and queued rows get in between.
+#define RETENTION_BATCH_ROWS 500
+#define RETENTION_BATCH_PAGES 256
+// Pause between steps while there is still work left, and between checks
+// once there is none.
+#define RETENTION_STEP_INTERVAL G_GINT64_CONSTANT(100000)
+#define RETENTION_IDLE_INTERVAL G_GINT64_CONSTANT(60000000)
+// Nothing touches the history tables this soon after start unless a
+// notification arrives first.
+#define HISTORY_OPEN_DELAY G_GINT64_CONSTANT(10000000)
+
+typedef struct {
+  gint64 serial;
+  gint64 time;
+  gchar* application_name;
+  gchar* notification_name;
+  gchar* title;
+  gchar* text;
+  gchar* icon;
+  gchar* url;
+  gchar* received;
+} HISTORY_ENTRY;
+
+static GAsyncQueue* queue;
+static GThread* writer;
+static gchar* history_path;
+static sqlite3* history_db; // NULL until first needed, or if it can't be opened
+static sqlite3_stmt* insert_stmt;
+// Indexes a row the triggers skipped because it was stored compressed.
+static sqlite3_stmt* index_stmt; // NULL without the full-text index
+static HISTORY_CODEC* codec; // NULL if title and text are stored as is
+static gint compression_level; // not positive to store them as is
+static guint dict_rows;
+// Set by history_use_log(); rows then go to the log instead of the table.
+static gchar* log_dir;
+static HISTORY_LOG* history_log;
+static gint64 flush_interval; // usec
+static guint batch_rows;
+
+static gint max_age;   // days
+static gint max_rows;
+static gint max_bytes;
+static gboolean incremental_vacuum;
+static gboolean vacuum_checked;
+
+static guint written_rows;
+static guint commits;
+static guint expired_rows;
+
+// Numbers handed out by history_append(), under the queue's lock so they
+// are in queue order.
+static gint64 appended;
+// The newest row the writer is done with, and the rowid it left behind.
+G_LOCK_DEFINE_STATIC(committed);
+static gint64 committed_serial;
+static sqlite3_int64 committed_rowid;
+static gboolean table_open;
+// As of opening the table, before any row went in.
+static gint64 opened_serial;
+static sqlite3_int64 opened_rowid;
+static sqlite3_int64 inserted_rowid; // writer only
+
+// Pushed by history_term(); never freed.
+static HISTORY_ENTRY stop_marker;
+
+static void
+free_history_entry(HISTORY_ENTRY* const e) {
+  g_free(e->application_name);
+  g_free(e->notification_name);
+  g_free(e->title);
+  g_free(e->text);
+  g_free(e->icon);
+  g_free(e->url);
+  g_free(e->received);
+  g_free(e);
+}
+
+static HISTORY_ENTRY*
+pop_until(const gint64 deadline) {
+  const gint64 wait = deadline - g_get_monotonic_time();
+  if (wait <= 0) return (HISTORY_ENTRY*) g_async_queue_try_pop(queue);
+#if GLIB_CHECK_VERSION(2,31,18)
+  return (HISTORY_ENTRY*) g_async_queue_timeout_pop(queue, wait);
+#else
+  GTimeVal until;
+  g_get_current_time(&until);
+  g_time_val_add(&until, wait);
+  return (HISTORY_ENTRY*) g_async_queue_timed_pop(queue, &until);
+#endif
+}
+
+static void
+exec_history(const char* const sql) {
+  if (!history_db) return;
+  if (sqlite3_exec(history_db, sql, NULL, NULL, NULL) != SQLITE_OK)
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(history_db));
+}
+
+static void
+insert_entry(HISTORY_ENTRY* const e) {
+  if (history_log) {
+    const HISTORY_RECORD record = {
+      e->time, e->application_name, e->title, e->text, e->icon, e->url, e->received,
+      e->notification_name,
+    };
+    if (history_log_append(history_log, &record))
+      g_atomic_int_inc((gint*) &written_rows);
+    free_history_entry(e);
+    return;
+  }
+  if (!insert_stmt) {
+    free_history_entry(e);
+    return;
+  }
+  history_codec_bind(codec, insert_stmt, 1, e->title);
+  history_codec_bind(codec, insert_stmt, 2, e->text);
+  sqlite3_bind_text(insert_stmt, 3, e->icon, -1, SQLITE_STATIC);
+  sqlite3_bind_text(insert_stmt, 4, e->url, -1, SQLITE_STATIC);
+  sqlite3_bind_text(insert_stmt, 5, e->received, -1, SQLITE_STATIC);
+  sqlite3_bind_text(insert_stmt, 6, e->application_name, -1, SQLITE_STATIC);
+  sqlite3_bind_text(insert_stmt, 7, e->notification_name, -1, SQLITE_STATIC);
+  if (sqlite3_step(insert_stmt) != SQLITE_DONE) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(history_db));
+  } else {
+    g_atomic_int_inc((gint*) &written_rows);
+    inserted_rowid = sqlite3_last_insert_rowid(history_db);
+    if (index_stmt) {
+      sqlite3_bind_text(index_stmt, 1, e->title, -1, SQLITE_STATIC);
+      sqlite3_bind_text(index_stmt, 2, e->text, -1, SQLITE_STATIC);
+      sqlite3_bind_int64(index_stmt, 3, inserted_rowid);
+      if (sqlite3_step(index_stmt) != SQLITE_DONE)
+        gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(history_db));
+      sqlite3_reset(index_stmt);
+      sqlite3_clear_bindings(index_stmt);
+    }
+  }
+  sqlite3_reset(insert_stmt);
+  sqlite3_clear_bindings(insert_stmt);
+  free_history_entry(e);
+}
+
+static gint64
+query_history_int(const char* const sql) {
+  sqlite3_stmt* stmt;
+  gint64 value = 0;
+  if (sqlite3_prepare_v2(history_db, sql, -1, &stmt, NULL) != SQLITE_OK) return 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) value = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return value;
+}
+
+// Deletes up to `limit` of the oldest rows, optionally only those older
+// than max_age. Returns the number deleted.
+static gint
+expire_oldest(const gint limit, const gboolean by_age) {
+  gchar* const sql = by_age
+    ? sqlite3_mprintf(
+        "insert into expiring select rowid from notification"
+        " where received < datetime('now', '-%d days') order by received limit %d",
+        max_age, limit)
+    : sqlite3_mprintf(
+        "insert into expiring select rowid from notification"
+        " order by received limit %d", limit);
+  exec_history("begin");
+  exec_history("delete from expiring");
+  exec_history(sql);
+  sqlite3_free(sql);
+  // The delete trigger only handles rows stored as text.
+  if (index_stmt)
+    exec_history(
+        "insert into notification_fts(notification_fts, rowid, title, text, app_name)"
+        " select 'delete', rowid, history_text(title), history_text(text), app_name"
+        " from notification where rowid in (select id from expiring)"
+        " and (typeof(title) = 'blob' or typeof(text) = 'blob')");
+  exec_history("delete from notification where rowid in (select id from expiring)");
+  const gint deleted = sqlite3_changes(history_db);
+  exec_history("commit");
+  g_atomic_int_add((gint*) &expired_rows, deleted);
+  return deleted;
+}
+
+static gboolean convert_auto_vacuum();
+
+// One step of retention: drop a batch of rows past any of the limits, then
+// hand a batch of free pages back to the file system. Returns TRUE if
+// there is more to do.
+static gboolean
+enforce_retention() {
+  // The log drops whole segments at once, so there is never more to do.
+  if (history_log) {
+    g_atomic_int_add((gint*) &expired_rows, history_log_expire(history_log,
+          max_age > 0 ? (gint64) time(NULL) - (gint64) max_age * 24 * 60 * 60 : 0,
+          MAX(max_rows, 0), MAX(max_bytes, 0)));
+    return FALSE;
+  }
+
+  gboolean more = FALSE;
+
+  if (max_age > 0)
+    more |= expire_oldest(RETENTION_BATCH_ROWS, TRUE) == RETENTION_BATCH_ROWS;
+
+  if (max_rows > 0) {
+    const gint64 excess = query_history_int("select count(*) from notification") - max_rows;
+    if (excess > 0) {
+      expire_oldest((gint) MIN(excess, RETENTION_BATCH_ROWS), FALSE);
+      more |= excess > RETENTION_BATCH_ROWS;
+    }
+  }
+
+  if (max_bytes > 0) {
+    const gint64 used =
+      (query_history_int("pragma page_count") - query_history_int("pragma freelist_count"))
+      * query_history_int("pragma page_size");
+    if (used > max_bytes) more |= expire_oldest(RETENTION_BATCH_ROWS, FALSE) > 0;
+  }
+
+  if (incremental_vacuum) {
+    gchar* const sql = sqlite3_mprintf("pragma incremental_vacuum(%d)", RETENTION_BATCH_PAGES);
+    exec_history(sql);
+    sqlite3_free(sql);
+    more |= query_history_int("pragma freelist_count") > 0;
+  }
+
+  // Only once caught up with the limits, when there is the least to copy.
+  if (!more && !incremental_vacuum && !vacuum_checked
+      && (max_age > 0 || max_rows > 0 || max_bytes > 0)) {
+    vacuum_checked = TRUE;
+    convert_auto_vacuum();
+  }
+  return more;
+}
+
+static void
+rebuild_search_index() {
+  exec_history("insert into notification_fts(notification_fts) values('delete-all')");
+  exec_history(
+      "insert into notification_fts(rowid, title, text, app_name)"
+      " select rowid, history_text(title), history_text(text), app_name from notification");
+}
+
+// Incremental vacuum only works if the file was built for it. Older
+// databases are rebuilt once, which needs up to twice their size on disk
+// and holds the write lock throughout, so only when retention is on and
+// from the idle retention step, never while opening.
+static gboolean
+convert_auto_vacuum() {
+  exec_history("pragma auto_vacuum=incremental");
+  exec_history("vacuum");
+  incremental_vacuum = query_history_int("pragma auto_vacuum") == 2;
+  if (!incremental_vacuum) return FALSE;
+  if (index_stmt) rebuild_search_index();
+  return TRUE;
+}
+
+static gboolean
+has_search_index(sqlite3* const db) {
+  sqlite3_stmt* stmt;
+  gboolean found = FALSE;
+  if (sqlite3_prepare_v2(db,
+        "select count(*) from sqlite_master where name = 'notification_fts'",
+        -1, &stmt, NULL) != SQLITE_OK) return FALSE;
+  if (sqlite3_step(stmt) == SQLITE_ROW) found = sqlite3_column_int(stmt, 0) > 0;
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+// The full-text index only stores its own terms and points back at the
+// notification table by rowid. It indexes title and text as history_text()
+// reads them back, so compressed rows are searchable too. Triggers keep it
+// in step for rows stored as text, whoever writes them; they only use the
+// raw columns, so the schema never depends on history_text(). Compressed
+// rows are indexed and unindexed by the writer itself. FTS5's own rebuild
+// would read the raw columns, hence the select. VACUUM may renumber rowids,
+// so the index is rebuilt after one.
+static void
+prepare_search_index(gboolean rebuild) {
+  if (!has_search_index(history_db)) {
+    if (sqlite3_exec(history_db,
+          "create virtual table notification_fts using fts5("
+          "title, text, app_name, content='notification', content_rowid='rowid')",
+          NULL, NULL, NULL) != SQLITE_OK) {
+      // Built without FTS5; history_search() falls back to a scan.
+      gol_debug_warning("full-text search unavailable.\n\t%s", sqlite3_errmsg(history_db));
+      return;
+    }
+    rebuild = TRUE;
+  }
+  // Recreated every time, to replace any that called history_text().
+  exec_history("drop trigger if exists notification_fts_insert");
+  exec_history("drop trigger if exists notification_fts_delete");
+  exec_history(
+      "create trigger notification_fts_insert"
+      " after insert on notification"
+      " when typeof(new.title) <> 'blob' and typeof(new.text) <> 'blob' begin"
+      " insert into notification_fts(rowid, title, text, app_name)"
+      " values(new.rowid, new.title, new.text, new.app_name);"
+      " end");
+  exec_history(
+      "create trigger notification_fts_delete"
+      " after delete on notification"
+      " when typeof(old.title) <> 'blob' and typeof(old.text) <> 'blob' begin"
+      " insert into notification_fts(notification_fts, rowid, title, text, app_name)"
+      " values('delete', old.rowid, old.title, old.text, old.app_name);"
+      " end");
+  if (sqlite3_prepare_v2(history_db,
+        "insert into notification_fts(rowid, title, text, app_name)"
+        " select rowid, ?, ?, app_name from notification where rowid = ?3"
+        " and (typeof(title) = 'blob' or typeof(text) = 'blob')",
+        -1, &index_stmt, NULL) != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(history_db));
+    index_stmt = NULL;
+  }
+  if (rebuild) rebuild_search_index();
+}
+
+// Blocks for the first row of a batch, then keeps collecting until the
+// batch is full or the interval since that row has passed, and commits
+// them in one transaction. Retention runs in between when nothing is
+// queued.
+static gboolean
+open_history_db() {
+  if (log_dir) {
+    history_log = history_log_open(log_dir, TRUE);
+    return history_log != NULL;
+  }
+  if (sqlite3_open(history_path, &history_db) != SQLITE_OK) {
+    g_critical("Can't open database: %s", history_path);
+    sqlite3_close(history_db);
+    history_db = NULL;
+    return FALSE;
+  }
+  // Readers on the other connection keep going while a batch is written,
+  // and a commit no longer waits for the disk.
+  sqlite3_busy_timeout(history_db, 5000);
+  history_codec_register(history_db);
+  exec_history("pragma journal_mode=wal");
+  exec_history("pragma synchronous=normal");
+  // Databases from before the columns existed; fails harmlessly otherwise.
+  sqlite3_exec(history_db, "alter table notification add column app_name text", NULL, NULL, NULL);
+  sqlite3_exec(history_db, "alter table notification add column name text", NULL, NULL, NULL);
+  exec_history("create index if not exists notification_received on notification(received)");
+  exec_history("create index if not exists notification_app_name on notification(app_name)");
+  // Rows picked for expiry, so the index and the table drop the same ones.
+  exec_history("create temp table if not exists expiring(id integer primary key)");
+
+  if (sqlite3_prepare_v2(history_db,
+        "insert into notification(title, text, icon, url, received, app_name, name)"
+        " values(?, ?, ?, ?, ?, ?, ?)", -1, &insert_stmt, NULL) != SQLITE_OK) {
+    g_critical("Can't prepare history insert: %s", sqlite3_errmsg(history_db));
+    sqlite3_close(history_db);
+    history_db = NULL;
+    return FALSE;
+  }
+
+  incremental_vacuum = query_history_int("pragma auto_vacuum") == 2;
+  prepare_search_index(FALSE);
+  if (compression_level > 0)
+    codec = history_codec_new(history_db, compression_level, dict_rows);
+
+  inserted_rowid = query_history_int("select max(rowid) from notification");
+  G_LOCK(committed);
+  table_open = TRUE;
+  opened_serial = committed_serial;
+  opened_rowid = committed_rowid = inserted_rowid;
+  G_UNLOCK(committed);
+  return TRUE;
+}
+
+// Rows up to `serial` are in, or dropped if they couldn't be written.
+static void
+publish_committed(const gint64 serial) {
+  G_LOCK(committed);
+  committed_serial = serial;
+  if (table_open) committed_rowid = inserted_rowid;
+  G_UNLOCK(committed);
+}
+
+static gpointer
+history_proc(gpointer GOL_UNUSED_ARG(data)) {
+  gboolean opened = FALSE;
+  gint64 next_retention = g_get_monotonic_time() + HISTORY_OPEN_DELAY;
+  gboolean stopping = FALSE;
+  while (!stopping) {
+    HISTORY_ENTRY* e = pop_until(next_retention);
+    if (e == &stop_marker) break;
+    if (!opened) {
+      // Rows are dropped, not kept queued, if the database can't be used.
+      open_history_db();
+      opened = TRUE;
+    }
+    if (!e) {
+      next_retention = g_get_monotonic_time() + ((history_db || history_log) && enforce_retention()
+          ? RETENTION_STEP_INTERVAL : RETENTION_IDLE_INTERVAL);
+      continue;
+    }
+
+    const gint64 deadline = g_get_monotonic_time() + flush_interval;
+    gint64 serial = e->serial;
+    exec_history("begin");
+    insert_entry(e);
+    for (guint n = 1; n < batch_rows; ++n) {
+      if (!(e = pop_until(deadline))) break;
+      if (e == &stop_marker) {
+        stopping = TRUE;
+        break;
+      }
+      serial = e->serial;
+      insert_entry(e);
+    }
+    exec_history("commit");
+    if (history_log) history_log_flush(history_log);
+    publish_committed(serial);
+    history_codec_maintain(codec);
+    g_atomic_int_inc((gint*) &commits);
+  }
+  return NULL;
+}
+
+void
+history_init(const gint interval, const gint batch) {
+  flush_interval = (gint64) MAX(interval, 0) * 1000;
+  batch_rows = MAX(batch, 1);
+  queue = g_async_queue_new();
+}
+
+gboolean
+history_open(const gchar* const path) {
+  if (!queue || writer) return FALSE;
+  history_path = g_strdup(path);
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+  writer = g_thread_create(history_proc, NULL, TRUE, NULL);
+#else
+  writer = g_thread_try_new("history", history_proc, NULL, NULL);
+#endif
+  if (!writer) {
+    g_critical("Can't start history writer");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+void
+history_term() {
+  if (writer) {
+    g_async_queue_push(queue, &stop_marker);
+    g_thread_join(writer);
+    writer = NULL;
+  }
+  if (queue) {
+    HISTORY_ENTRY* e;
+    while ((e = (HISTORY_ENTRY*) g_async_queue_try_pop(queue)))
+      if (e != &stop_marker) free_history_entry(e);
+    g_async_queue_unref(queue);
+    queue = NULL;
+  }
+  if (insert_stmt) sqlite3_finalize(insert_stmt);
+  insert_stmt = NULL;
+  if (index_stmt) sqlite3_finalize(index_stmt);
+  index_stmt = NULL;
+  history_codec_free(codec);
+  codec = NULL;
+  if (history_db) sqlite3_close(history_db);
+  history_db = NULL;
+  history_log_close(history_log);
+  history_log = NULL;
+  g_free(history_path);
+  history_path = NULL;
+  g_free(log_dir);
+  log_dir = NULL;
+}
+
+gint64
+history_append(const gchar* const application_name, const gchar* const notification_name,
+    const gchar* const title, const gchar* const text, const gchar* const icon,
+    const gchar* const url, const gchar* const received) {
+  if (!queue) return 0;
+  HISTORY_ENTRY* const e = g_new(HISTORY_ENTRY, 1);
+  e->time = time(NULL);
+  e->application_name = g_strdup(application_name);
+  e->notification_name = g_strdup(notification_name ? notification_name : "");
+  e->title = g_strdup(title);
+  e->text = g_strdup(text);
+  e->icon = g_strdup(icon ? icon : "");
+  e->url = g_strdup(url ? url : "");
+  e->received = g_strdup(received);
+  g_async_queue_lock(queue);
+  const gint64 serial = e->serial = ++appended;
+  g_async_queue_push_unlocked(queue, e);
+  g_async_queue_unlock(queue);
+  return serial;
+}
+
+gint64
+history_committed() {
+  G_LOCK(committed);
+  const gint64 serial = committed_serial;
+  G_UNLOCK(committed);
+  return serial;
+}
+
+gint64
+history_snapshot(sqlite3* const db, sqlite3_int64* const top) {
+  G_LOCK(committed);
+  const gboolean open = table_open;
+  gint64 serial = committed_serial;
+  *top = committed_rowid;
+  G_UNLOCK(committed);
+  if (open) return serial;
+
+  // None of the rows queued are in the table yet, unless the writer opens
+  // it and commits some while this looks.
+  *top = 0;
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(db, "select max(rowid) from notification", -1, &stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_step(stmt) == SQLITE_ROW) *top = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+  }
+  G_LOCK(committed);
+  if (table_open) {
+    *top = MIN(*top, opened_rowid);
+    serial = opened_serial;
+  }
+  G_UNLOCK(committed);
+  return serial;
+}
+
+// Every word is matched as a literal term, so punctuation in what the user
+// typed can't turn into FTS5 syntax; a trailing * keeps its prefix meaning.
+// NULL if there are no words.
+static gchar*
+build_match_query(const gchar* const query) {
+  GString* const match = g_string_new(NULL);
+  gchar** const words = g_strsplit_set(query, " \t\r\n", -1);
+  for (gint n = 0; words[n]; ++n) {
+    gchar* word = words[n];
+    if (!*word) continue;
+    const gsize len = strlen(word);
+    const gboolean prefix = len > 1 && word[len - 1] == '*';
+    if (prefix) word[len - 1] = '\0';
+
+    if (match->len) g_string_append_c(match, ' ');
+    g_string_append_c(match, '"');
+    for (const gchar* p = word; *p; p++) {
+      if (*p == '"') g_string_append_c(match, '"');
+      g_string_append_c(match, *p);
+    }
+    g_string_append_c(match, '"');
+    if (prefix) g_string_append_c(match, '*');
+  }
+  g_strfreev(words);
+  return g_string_free(match, !match->len);
+}
+
+gboolean
+history_search(sqlite3* const db, const gchar* const query, const gint limit,
+    const history_func_t func, gpointer const user_data) {
+  // Nothing to look for; FTS5 would take an empty MATCH as a syntax error.
+  gchar* match = build_match_query(query);
+  if (!match) return TRUE;
+
+  sqlite3_stmt* stmt;
+  int rc;
+  if (has_search_index(db)) {
+    rc = sqlite3_prepare_v2(db,
+        "select n.received, n.app_name, history_text(n.title), history_text(n.text)"
+        " from notification_fts f join notification n on n.rowid = f.rowid"
+        " where notification_fts match ? order by f.rowid desc limit ?",
+        -1, &stmt, NULL);
+  } else {
+    g_free(match);
+    match = NULL;
+    rc = sqlite3_prepare_v2(db,
+        "select received, app_name, history_text(title), history_text(text)"
+        " from notification where instr(history_text(title), ?1)"
+        " or instr(history_text(text), ?1) or instr(app_name, ?1)"
+        " order by rowid desc limit ?2",
+        -1, &stmt, NULL);
+  }
+  if (rc != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+    g_free(match);
+    return FALSE;
+  }
+
+  sqlite3_bind_text(stmt, 1, match ? match : query, -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, limit > 0 ? limit : -1);
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    func((const gchar*) sqlite3_column_text(stmt, 0),
+        (const gchar*) sqlite3_column_text(stmt, 1),
+        (const gchar*) sqlite3_column_text(stmt, 2),
+        (const gchar*) sqlite3_column_text(stmt, 3),
+        user_data);
+  }
+  if (rc != SQLITE_DONE)
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+  sqlite3_finalize(stmt);
+  g_free(match);
+  return rc == SQLITE_DONE;
+}
+
+void
+history_use_log(const gchar* const dir) {
+  g_free(log_dir);
+  log_dir = g_strdup(dir);
+}
+
+void
+history_set_compression(const gint level, const gint rotate_rows) {
+  compression_level = level;
+  dict_rows = (guint) MAX(rotate_rows, 1);
+}
+
+void
+history_set_retention(const gint age, const gint rows, const gint bytes) {
+  max_age = age;
+  max_rows = rows;
+  max_bytes = bytes;
+}
+
+void
+history_stats(guint* const rows, guint* const batches, guint* const expired) {
+  *rows = (guint) g_atomic_int_get((gint*) &written_rows);
+  *batches = (guint) g_atomic_int_get((gint*) &commits);
+  *expired = (guint) g_atomic_int_get((gint*) &expired_rows);
+}
+
+// vim:set et sw=2 ts=2 ai:
@@ -0,0 +1,82 @@
+#ifndef history_h_
+#define history_h_
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Rows are committed together once `batch` of them are queued or
+// `interval` milliseconds after the first one, whichever comes first.
+// From here on rows can be appended; they wait until history_open().
+void
+history_init(gint interval, gint batch);
+
+// Start the writer thread. It opens its own connection to `path` when the
+// first row arrives or retention is first due, not before.
+gboolean
+history_open(const gchar* path);
+
+// Commit whatever is still queued and stop the writer.
+void
+history_term();
+
+// Queue a row for the notification table. Safe to call from any thread;
+// the strings are copied. Returns the row's number: rows are numbered from
+// 1 in the order they are queued.
+gint64
+history_append(const gchar* application_name, const gchar* notification_name,
+    const gchar* title, const gchar* text, const gchar* icon,
+    const gchar* url, const gchar* received);
+
+// Number of the newest row the writer is done with; the rows before it
+// are too, written or dropped.
+gint64
+history_committed();
+
+// Where a view of the table on `db`, the caller's connection, should stop
+// so that it holds the rows queued up to the returned number, and none
+// queued after: those with a rowid up to `top`. Nothing to do with the log.
+gint64
+history_snapshot(sqlite3* db, sqlite3_int64* top);
+
+typedef void (*history_func_t)(const gchar* received, const gchar* application_name,
+    const gchar* title, const gchar* text, gpointer user_data);
+
+// Calls `func` for each row whose title, text or application contains every
+// word of `query`, newest first, at most `limit` rows (no limit if not
+// positive). Rows are passed on as they are read, on the caller's thread
+// and connection. Without the full-text index, falls back to a substring
+// scan for the whole query.
+gboolean
+history_search(sqlite3* db, const gchar* query, gint limit,
+    history_func_t func, gpointer user_data);
+
+// Keep rows in the append-only log in `dir` (see history_log.h) instead of
+// the notification table. Call before history_open().
+void
+history_use_log(const gchar* dir);
+
+// Store title and text compressed at zstd `level`, with a dictionary
+// retrained every `rotate_rows` rows (see history_codec.h); not positive to
+// store them as is. Has no effect when built without zstd or with the log.
+// Call before history_open().
+void
+history_set_compression(gint level, gint rotate_rows);
+
+// Rows are removed oldest first once they are older than `max_age` days,
+// there are more than `max_rows` of them or the database uses more than
+// `max_bytes`; zero or negative disables a limit. Call before history_init().
+void
+history_set_retention(gint max_age, gint max_rows, gint max_bytes);
+
+void
+history_stats(guint* rows, guint* batches, guint* expired);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* history_h_ */
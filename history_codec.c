@@ -0,0 +1,378 @@
+#include <string.h>
+
+#include <glib.h>
+#include <sqlite3.h>
+#ifdef HAVE_ZSTD
+# include <zstd.h>
+# include <zdict.h>
+#endif
+
+#include "gol.h"
+#include "history_codec.h"
+
+// A compressed value is the id of its dictionary (0 for none), little
+// endian, followed by a zstd frame without a dictionary id or checksum.
+#define FRAME_OFFSET 4
+// Shorter text never gets smaller, so it isn't tried.
+#define MIN_COMPRESS_BYTES 24
+#define DICT_BYTES (16 * 1024)
+// Rows a dictionary is trained from, newest first, and the fewest values
+// worth training on.
+#define TRAINING_ROWS 4000
+#define MIN_TRAINING_VALUES 200
+// After a failed training, e.g. with too little history.
+#define RETRY_ROWS 1000
+
+static guint64 raw_bytes;
+static guint64 stored_bytes;
+static guint trainings;
+G_LOCK_DEFINE_STATIC(stats);
+
+static void
+count_bytes(const gsize raw, const gsize stored) {
+  G_LOCK(stats);
+  raw_bytes += raw;
+  stored_bytes += stored;
+  G_UNLOCK(stats);
+}
+
+#ifdef HAVE_ZSTD
+static guint32
+read_le32(const guchar* const p) {
+  return (guint32) p[0] | (guint32) p[1] << 8 | (guint32) p[2] << 16 | (guint32) p[3] << 24;
+}
+
+static void
+write_le32(guchar* const p, const guint32 value) {
+  p[0] = value & 0xff;
+  p[1] = (value >> 8) & 0xff;
+  p[2] = (value >> 16) & 0xff;
+  p[3] = (value >> 24) & 0xff;
+}
+
+// Per connection, so only ever used by one thread at a time.
+typedef struct {
+  ZSTD_DCtx* dctx;
+  GHashTable* ddicts; // dictionary id -> ZSTD_DDict*, loaded when first needed
+} CODEC_READER;
+
+static void
+free_ddict(gpointer data) {
+  ZSTD_freeDDict((ZSTD_DDict*) data);
+}
+
+static void
+free_reader(void* data) {
+  CODEC_READER* const reader = (CODEC_READER*) data;
+  ZSTD_freeDCtx(reader->dctx);
+  g_hash_table_destroy(reader->ddicts);
+  g_free(reader);
+}
+
+static const ZSTD_DDict*
+lookup_ddict(CODEC_READER* const reader, sqlite3* const db, const guint32 id) {
+  ZSTD_DDict* ddict = (ZSTD_DDict*) g_hash_table_lookup(reader->ddicts, GUINT_TO_POINTER(id));
+  if (ddict) return ddict;
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(db, "select dict from history_dict where id = ?",
+        -1, &stmt, NULL) != SQLITE_OK) return NULL;
+  sqlite3_bind_int64(stmt, 1, id);
+  if (sqlite3_step(stmt) == SQLITE_ROW)
+    ddict = ZSTD_createDDict(sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+  sqlite3_finalize(stmt);
+  if (ddict) g_hash_table_insert(reader->ddicts, GUINT_TO_POINTER(id), ddict);
+  return ddict;
+}
+
+static gchar*
+decompress(CODEC_READER* const reader, sqlite3* const db,
+    const guchar* const blob, const gsize length, gsize* const text_length) {
+  if (length < FRAME_OFFSET) return NULL;
+  const guint32 id = read_le32(blob);
+  const ZSTD_DDict* const ddict = id ? lookup_ddict(reader, db, id) : NULL;
+  if (id && !ddict) return NULL;
+
+  const guchar* const frame = blob + FRAME_OFFSET;
+  const gsize frame_length = length - FRAME_OFFSET;
+  const unsigned long long size = ZSTD_getFrameContentSize(frame, frame_length);
+  if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR || size >= G_MAXINT)
+    return NULL;
+  gchar* const text = (gchar*) g_malloc((gsize) size + 1);
+  const size_t n = ddict
+    ? ZSTD_decompress_usingDDict(reader->dctx, text, (size_t) size, frame, frame_length, ddict)
+    : ZSTD_decompressDCtx(reader->dctx, text, (size_t) size, frame, frame_length);
+  if (ZSTD_isError(n) || n != size) {
+    g_free(text);
+    return NULL;
+  }
+  text[n] = '\0';
+  *text_length = n;
+  return text;
+}
+#endif
+
+// Values that aren't blobs were stored as text and pass through. A blob
+// that can't be read, e.g. without zstd, comes back as NULL.
+static void
+history_text(sqlite3_context* const context, int GOL_UNUSED_ARG(argc), sqlite3_value** const argv) {
+  sqlite3_value* const value = argv[0];
+  if (sqlite3_value_type(value) != SQLITE_BLOB) {
+    sqlite3_result_value(context, value);
+    return;
+  }
+#ifdef HAVE_ZSTD
+  gsize length;
+  gchar* const text = decompress((CODEC_READER*) sqlite3_user_data(context),
+      sqlite3_context_db_handle(context),
+      (const guchar*) sqlite3_value_blob(value), (gsize) sqlite3_value_bytes(value), &length);
+  if (text) {
+    sqlite3_result_text(context, text, (int) length, g_free);
+    return;
+  }
+#endif
+  sqlite3_result_null(context);
+}
+
+gboolean
+history_codec_register(sqlite3* const db) {
+  void* data = NULL;
+  void (*destroy)(void*) = NULL;
+#ifdef HAVE_ZSTD
+  CODEC_READER* const reader = g_new0(CODEC_READER, 1);
+  reader->dctx = ZSTD_createDCtx();
+  reader->ddicts = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_ddict);
+  data = reader;
+  destroy = free_reader;
+#endif
+#ifndef SQLITE_INNOCUOUS
+#define SQLITE_INNOCUOUS 0
+#endif
+  // On failure SQLite calls destroy itself. Innocuous, so it may still be
+  // used in views and the like where trusted_schema is off.
+  if (sqlite3_create_function_v2(db, "history_text", 1,
+        SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS,
+        data, history_text, NULL, NULL,
+        destroy) != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+#ifdef HAVE_ZSTD
+struct _HISTORY_CODEC {
+  sqlite3* db;
+  gint level;
+  guint rotate_rows;
+  ZSTD_CCtx* cctx;
+  ZSTD_CDict* cdict;   // NULL until the first dictionary is trained
+  guint32 dict_id;
+  sqlite3_int64 next_training; // rowid at which the next one is due
+};
+
+static sqlite3_int64
+last_rowid(sqlite3* const db) {
+  sqlite3_stmt* stmt;
+  sqlite3_int64 rowid = 0;
+  if (sqlite3_prepare_v2(db, "select max(rowid) from notification",
+        -1, &stmt, NULL) != SQLITE_OK) return 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) rowid = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  return rowid;
+}
+
+static void
+use_dictionary(HISTORY_CODEC* const codec, const guint32 id,
+    const void* const dict, const gsize size) {
+  ZSTD_CDict* const cdict = ZSTD_createCDict(dict, size, codec->level);
+  if (!cdict) return;
+  ZSTD_CCtx_refCDict(codec->cctx, cdict);
+  if (codec->cdict) ZSTD_freeCDict(codec->cdict);
+  codec->cdict = cdict;
+  codec->dict_id = id;
+}
+
+HISTORY_CODEC*
+history_codec_new(sqlite3* const db, const gint level, const guint rotate_rows) {
+  if (sqlite3_exec(db, "create table if not exists history_dict("
+        "id integer primary key, dict blob not null, created timestamp not null)",
+        NULL, NULL, NULL) != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+    return NULL;
+  }
+
+  HISTORY_CODEC* const codec = g_new0(HISTORY_CODEC, 1);
+  codec->db = db;
+  codec->level = level;
+  codec->rotate_rows = MAX(rotate_rows, 1);
+  codec->cctx = ZSTD_createCCtx();
+  ZSTD_CCtx_setParameter(codec->cctx, ZSTD_c_compressionLevel, level);
+  ZSTD_CCtx_setParameter(codec->cctx, ZSTD_c_contentSizeFlag, 1);
+  ZSTD_CCtx_setParameter(codec->cctx, ZSTD_c_checksumFlag, 0);
+  ZSTD_CCtx_setParameter(codec->cctx, ZSTD_c_dictIDFlag, 0);
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(db, "select id, dict from history_dict order by id desc limit 1",
+        -1, &stmt, NULL) == SQLITE_OK) {
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      use_dictionary(codec, (guint32) sqlite3_column_int64(stmt, 0),
+          sqlite3_column_blob(stmt, 1), sqlite3_column_bytes(stmt, 1));
+    }
+    sqlite3_finalize(stmt);
+  }
+  // Without a dictionary, one is trained as soon as there are rows for it.
+  codec->next_training = codec->cdict ? last_rowid(db) + codec->rotate_rows : 0;
+  return codec;
+}
+
+void
+history_codec_free(HISTORY_CODEC* const codec) {
+  if (!codec) return;
+  ZSTD_freeCCtx(codec->cctx);
+  if (codec->cdict) ZSTD_freeCDict(codec->cdict);
+  g_free(codec);
+}
+
+void
+history_codec_bind(HISTORY_CODEC* const codec, sqlite3_stmt* const stmt,
+    const int index, const gchar* const text) {
+  const gsize length = text ? strlen(text) : 0;
+  if (!codec || length < MIN_COMPRESS_BYTES) {
+    sqlite3_bind_text(stmt, index, text, -1, SQLITE_STATIC);
+    count_bytes(length, length);
+    return;
+  }
+
+  const gsize capacity = FRAME_OFFSET + ZSTD_compressBound(length);
+  guchar* const blob = (guchar*) g_malloc(capacity);
+  write_le32(blob, codec->dict_id);
+  const size_t n = ZSTD_compress2(codec->cctx,
+      blob + FRAME_OFFSET, capacity - FRAME_OFFSET, text, length);
+  if (ZSTD_isError(n) || FRAME_OFFSET + n >= length) {
+    g_free(blob);
+    sqlite3_bind_text(stmt, index, text, -1, SQLITE_STATIC);
+    count_bytes(length, length);
+    return;
+  }
+  sqlite3_bind_blob(stmt, index, blob, (int) (FRAME_OFFSET + n), g_free);
+  count_bytes(length, FRAME_OFFSET + n);
+}
+
+// Samples the latest rows as they read back, so rows already compressed
+// train the next dictionary too.
+static gsize
+train(HISTORY_CODEC* const codec, void* const dict) {
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(codec->db,
+        "select history_text(title), history_text(text) from notification"
+        " order by rowid desc limit ?", -1, &stmt, NULL) != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(codec->db));
+    return 0;
+  }
+  sqlite3_bind_int(stmt, 1, TRAINING_ROWS);
+  GByteArray* const samples = g_byte_array_new();
+  GArray* const sizes = g_array_new(FALSE, FALSE, sizeof(size_t));
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    for (int n = 0; n < 2; ++n) {
+      const size_t size = (size_t) sqlite3_column_bytes(stmt, n);
+      if (!size) continue;
+      g_byte_array_append(samples, sqlite3_column_text(stmt, n), (guint) size);
+      g_array_append_val(sizes, size);
+    }
+  }
+  sqlite3_finalize(stmt);
+
+  gsize size = 0;
+  if (sizes->len >= MIN_TRAINING_VALUES) {
+    const size_t trained = ZDICT_trainFromBuffer(dict, DICT_BYTES,
+        samples->data, (const size_t*) sizes->data, sizes->len);
+    if (ZDICT_isError(trained))
+      gol_debug_warning("can't train history dictionary.\n\t%s", ZDICT_getErrorName(trained));
+    else
+      size = trained;
+  }
+  g_byte_array_free(samples, TRUE);
+  g_array_free(sizes, TRUE);
+  return size;
+}
+
+void
+history_codec_maintain(HISTORY_CODEC* const codec) {
+  if (!codec) return;
+  const sqlite3_int64 rowid = last_rowid(codec->db);
+  if (rowid < codec->next_training) return;
+
+  void* const dict = g_malloc(DICT_BYTES);
+  const gsize size = train(codec, dict);
+  if (!size) {
+    codec->next_training = rowid + RETRY_ROWS;
+    g_free(dict);
+    return;
+  }
+
+  sqlite3_exec(codec->db, "begin", NULL, NULL, NULL);
+  sqlite3_stmt* stmt;
+  gboolean stored = FALSE;
+  if (sqlite3_prepare_v2(codec->db,
+        "insert into history_dict(dict, created) values(?, datetime('now'))",
+        -1, &stmt, NULL) == SQLITE_OK) {
+    sqlite3_bind_blob(stmt, 1, dict, (int) size, SQLITE_STATIC);
+    stored = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+  }
+  // A dictionary is only used for rows written before the next one was
+  // created, so once a later one is older than every row it can go.
+  sqlite3_exec(codec->db,
+      "delete from history_dict where id < (select max(id) from history_dict"
+      " where created < (select min(received) from notification))",
+      NULL, NULL, NULL);
+  if (!stored || sqlite3_exec(codec->db, "commit", NULL, NULL, NULL) != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(codec->db));
+    sqlite3_exec(codec->db, "rollback", NULL, NULL, NULL);
+    codec->next_training = rowid + RETRY_ROWS;
+    g_free(dict);
+    return;
+  }
+
+  use_dictionary(codec, (guint32) sqlite3_last_insert_rowid(codec->db), dict, size);
+  codec->next_training = rowid + codec->rotate_rows;
+  g_free(dict);
+  G_LOCK(stats);
+  trainings++;
+  G_UNLOCK(stats);
+}
+#else
+HISTORY_CODEC*
+history_codec_new(sqlite3* GOL_UNUSED_ARG(db), gint GOL_UNUSED_ARG(level),
+    guint GOL_UNUSED_ARG(rotate_rows)) {
+  return NULL;
+}
+
+void
+history_codec_free(HISTORY_CODEC* GOL_UNUSED_ARG(codec)) {
+}
+
+void
+history_codec_bind(HISTORY_CODEC* GOL_UNUSED_ARG(codec), sqlite3_stmt* const stmt,
+    const int index, const gchar* const text) {
+  const gsize length = text ? strlen(text) : 0;
+  sqlite3_bind_text(stmt, index, text, -1, SQLITE_STATIC);
+  count_bytes(length, length);
+}
+
+void
+history_codec_maintain(HISTORY_CODEC* GOL_UNUSED_ARG(codec)) {
+}
+#endif
+
+void
+history_codec_stats(guint64* const raw, guint64* const stored, guint* const dictionaries) {
+  G_LOCK(stats);
+  *raw = raw_bytes;
+  *stored = stored_bytes;
+  *dictionaries = trainings;
+  G_UNLOCK(stats);
+}
+
+// vim:set et sw=2 ts=2 ai:
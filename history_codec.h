@@ -0,0 +1,52 @@
+#ifndef history_codec_h_
+#define history_codec_h_
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Title and text of history rows may be stored as zstd frames compressed
+// with a dictionary trained from earlier rows, kept in the history_dict
+// table. In SQL, history_text(column) reads either kind back as text.
+
+// Registers history_text() on `db`. Any connection that reads title or
+// text through it needs it. Nothing stored in the schema refers to it, so
+// connections without it can still write the table.
+gboolean
+history_codec_register(sqlite3* db);
+
+typedef struct _HISTORY_CODEC HISTORY_CODEC;
+
+// For the one connection that writes history, after
+// history_codec_register(). A new dictionary is trained every
+// `rotate_rows` rows. Returns NULL, and rows are stored as text, when
+// built without zstd.
+HISTORY_CODEC*
+history_codec_new(sqlite3* db, gint level, guint rotate_rows);
+
+void
+history_codec_free(HISTORY_CODEC* codec);
+
+// Binds `text` to parameter `index` of `stmt`, compressed if that makes it
+// smaller. `codec` may be NULL.
+void
+history_codec_bind(HISTORY_CODEC* codec, sqlite3_stmt* stmt, int index, const gchar* text);
+
+// Trains a new dictionary from the latest rows once it is due, and drops
+// the ones no remaining row was written with. Call between transactions.
+void
+history_codec_maintain(HISTORY_CODEC* codec);
+
+// Bytes of title and text written this session, before and after
+// compression, and the number of dictionaries trained.
+void
+history_codec_stats(guint64* raw, guint64* stored, guint* dictionaries);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* history_codec_h_ */
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "gol.h"
+#include "history_export.h"
+
+static const char* const export_columns[] = {
+  "received", "application", "notification", "title", "text", "icon", "url",
+};
+#define EXPORT_COLUMNS G_N_ELEMENTS(export_columns)
+
+static void
+write_json_string(FILE* const out, const gchar* const s) {
+  putc('"', out);
+  for (const guchar* p = (const guchar*) s; *p; p++) {
+    switch (*p) {
+    case '"': fputs("\\\"", out); break;
+    case '\\': fputs("\\\\", out); break;
+    case '\n': fputs("\\n", out); break;
+    case '\r': fputs("\\r", out); break;
+    case '\t': fputs("\\t", out); break;
+    default:
+      if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+      else putc(*p, out);
+    }
+  }
+  putc('"', out);
+}
+
+static void
+write_csv_field(FILE* const out, const gchar* s) {
+  if (!strpbrk(s, ",\"\r\n")) {
+    fputs(s, out);
+    return;
+  }
+  putc('"', out);
+  for (; *s; s++) {
+    if (*s == '"') putc('"', out);
+    putc(*s, out);
+  }
+  putc('"', out);
+}
+
+static gboolean
+write_header(FILE* const out, const history_export_format_t format) {
+  if (format != HISTORY_EXPORT_CSV) return TRUE;
+  for (guint n = 0; n < EXPORT_COLUMNS; ++n) {
+    if (n) putc(',', out);
+    fputs(export_columns[n], out);
+  }
+  putc('\n', out);
+  return !ferror(out);
+}
+
+// FALSE once the output can't be written, e.g. the reader of a pipe quit.
+static gboolean
+write_row(FILE* const out, const history_export_format_t format, const gchar* const values[]) {
+  for (guint n = 0; n < EXPORT_COLUMNS; ++n) {
+    const gchar* const value = values[n] ? values[n] : "";
+    if (format == HISTORY_EXPORT_CSV) {
+      if (n) putc(',', out);
+      write_csv_field(out, value);
+    } else {
+      fprintf(out, "%s\"%s\":", n ? "," : "{", export_columns[n]);
+      write_json_string(out, value);
+    }
+  }
+  if (format != HISTORY_EXPORT_CSV) putc('}', out);
+  putc('\n', out);
+  return !ferror(out);
+}
+
+void
+history_export_init(HISTORY_EXPORT* const export) {
+  export->format = HISTORY_EXPORT_JSON_LINES;
+  export->since = G_MININT64;
+  export->until = G_MAXINT64;
+  export->application_name = NULL;
+}
+
+gboolean
+history_export_parse_time(const gchar* const text, gint64* const time) {
+  gint year, month, day, hour = 0, minute = 0, second = 0, used = 0;
+  if (sscanf(text, "%4d-%2d-%2d%n", &year, &month, &day, &used) != 3) return FALSE;
+  const gchar* rest = text + used;
+  if (*rest == ' ' || *rest == 'T') {
+    if (sscanf(rest + 1, "%2d:%2d%n", &hour, &minute, &used) != 2) return FALSE;
+    rest += 1 + used;
+    if (*rest == ':') {
+      if (sscanf(rest + 1, "%2d%n", &second, &used) != 1) return FALSE;
+      rest += 1 + used;
+    }
+  }
+  if (*rest) return FALSE;
+
+  GDateTime* const dt = g_date_time_new_utc(year, month, day, hour, minute, second);
+  if (!dt) return FALSE;
+  *time = g_date_time_to_unix(dt);
+  g_date_time_unref(dt);
+  return TRUE;
+}
+
+gboolean
+history_export_db(sqlite3* const db, const HISTORY_EXPORT* const export, FILE* const out) {
+  // Ordering by received lets SQLite walk its index instead of sorting;
+  // the unary + keeps it from picking the app_name index for the filter.
+  GString* const sql = g_string_new(
+      "select received, app_name, name, history_text(title), history_text(text), icon, url"
+      " from notification where 1");
+  if (export->since != G_MININT64)
+    g_string_append(sql, " and received >= datetime(:since, 'unixepoch')");
+  if (export->until != G_MAXINT64)
+    g_string_append(sql, " and received < datetime(:until, 'unixepoch')");
+  if (export->application_name)
+    g_string_append(sql, " and +app_name = :app");
+  g_string_append(sql, " order by received");
+
+  sqlite3_stmt* stmt;
+  const int prepared = sqlite3_prepare_v2(db, sql->str, -1, &stmt, NULL);
+  g_string_free(sql, TRUE);
+  if (prepared != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+    return FALSE;
+  }
+  sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":since"), export->since);
+  sqlite3_bind_int64(stmt, sqlite3_bind_parameter_index(stmt, ":until"), export->until);
+  sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, ":app"),
+      export->application_name, -1, SQLITE_STATIC);
+
+  gboolean ok = write_header(out, export->format);
+  int rc = SQLITE_DONE;
+  while (ok && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    const gchar* values[EXPORT_COLUMNS];
+    for (guint n = 0; n < EXPORT_COLUMNS; ++n)
+      values[n] = (const gchar*) sqlite3_column_text(stmt, n);
+    ok = write_row(out, export->format, values);
+  }
+  if (ok && rc != SQLITE_DONE) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+    ok = FALSE;
+  }
+  sqlite3_finalize(stmt);
+  return ok;
+}
+
+typedef struct {
+  const HISTORY_EXPORT* export;
+  FILE* out;
+  gboolean ok;
+} LOG_EXPORT;
+
+static gboolean
+export_record(const HISTORY_RECORD* const record, gpointer const data) {
+  LOG_EXPORT* const e = (LOG_EXPORT*) data;
+  if (e->export->application_name
+      && strcmp(record->application_name, e->export->application_name))
+    return TRUE;
+  const gchar* const values[EXPORT_COLUMNS] = {
+    record->received, record->application_name, record->notification_name,
+    record->title, record->text, record->icon, record->url,
+  };
+  return e->ok = write_row(e->out, e->export->format, values);
+}
+
+gboolean
+history_export_log(HISTORY_LOG* const log, const HISTORY_EXPORT* const export, FILE* const out) {
+  LOG_EXPORT e = { export, out, write_header(out, export->format) };
+  if (e.ok) history_log_range(log, export->since, export->until, export_record, &e);
+  return e.ok;
+}
+
+// vim:set et sw=2 ts=2 ai:
@@ -0,0 +1,48 @@
+#ifndef history_export_h_
+#define history_export_h_
+
+#include <stdio.h>
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "history_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  HISTORY_EXPORT_JSON_LINES,
+  HISTORY_EXPORT_CSV,
+} history_export_format_t;
+
+typedef struct {
+  history_export_format_t format;
+  gint64 since;                  // seconds since the epoch, inclusive
+  gint64 until;                  // exclusive
+  const gchar* application_name; // NULL for every application
+} HISTORY_EXPORT;
+
+// Every row, in every format.
+void
+history_export_init(HISTORY_EXPORT* export);
+
+// "YYYY-MM-DD", optionally followed by " HH:MM" or " HH:MM:SS" (or with a
+// T in between), in UTC like the received column.
+gboolean
+history_export_parse_time(const gchar* text, gint64* time);
+
+// Rows go out oldest first, one at a time as they are read, so memory use
+// doesn't grow with the history. Returns FALSE on a read or write error.
+gboolean
+history_export_db(sqlite3* db, const HISTORY_EXPORT* export, FILE* out);
+
+gboolean
+history_export_log(HISTORY_LOG* log, const HISTORY_EXPORT* export, FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* history_export_h_ */
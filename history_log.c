@@ -0,0 +1,665 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+# include <io.h>
+#else
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "gol.h"
+#include "history_log.h"
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+#ifdef _WIN32
+# define ftruncate _chsize
+#endif
+
+// Space taken for a new segment up front; it is sealed, and cut down to
+// what it holds, once the next record doesn't fit.
+#define SEGMENT_BYTES (8 * 1024 * 1024)
+// Records between two entries of the index.
+#define INDEX_STRIDE 64
+
+// File layout, all integers little endian:
+//   segment: magic, records, then once sealed the index and the trailer
+//   record:  u32 length (padded to 8), u32 checksum of the rest,
+//            i64 time, u32 size of each field, the fields with their NULs
+//   index:   i64 time, u32 offset, u32 ordinal; one per INDEX_STRIDE records
+//   trailer: u32 magic, u32 index entries, u32 index offset, u32 records,
+//            i64 first time, i64 last time
+#define SEGMENT_MAGIC "GOLLOG2\n"
+#define SEGMENT_HEADER_SIZE 8
+#define RECORD_FIELDS 7
+// Segments written before notification names were kept have one field
+// less; they are still read, but never appended to.
+#define SEGMENT_MAGIC_V1 "GOLLOG1\n"
+#define RECORD_FIELDS_V1 6
+#define RECORD_HEADER_SIZE(fields) (16 + 4 * (fields))
+#define INDEX_ENTRY_SIZE 16
+#define TRAILER_MAGIC 0x58444e49
+#define TRAILER_SIZE 32
+
+typedef struct {
+  gint64 time;
+  guint32 offset;
+  guint32 ordinal;
+} INDEX_ENTRY;
+
+typedef struct {
+  guint number;
+  gchar* path;
+  GMappedFile* mapped;  // snapshots only
+  const guint8* data;   // snapshots only
+  guint32 end;          // past the last record
+  guint32 records;
+  gint64 first_time;
+  gint64 last_time;
+  guint64 bytes;        // on disk
+  gint fields;          // per record
+  gboolean sealed;
+  GArray* index;        // INDEX_ENTRY
+} SEGMENT;
+
+struct _HISTORY_LOG {
+  gchar* dir;
+  gboolean writable;
+  GPtrArray* segments;  // SEGMENT*, oldest first
+  guint64 records;
+  // The writer's last segment, while it is open for appending.
+  int fd;
+  guint8* base;
+  guint32 capacity;
+  guint32 synced;
+};
+
+static guint32
+get_u32(const guint8* const p) {
+  guint32 v;
+  memcpy(&v, p, sizeof(v));
+  return GUINT32_FROM_LE(v);
+}
+
+static gint64
+get_i64(const guint8* const p) {
+  gint64 v;
+  memcpy(&v, p, sizeof(v));
+  return GINT64_FROM_LE(v);
+}
+
+static void
+put_u32(guint8* const p, guint32 v) {
+  v = GUINT32_TO_LE(v);
+  memcpy(p, &v, sizeof(v));
+}
+
+static void
+put_i64(guint8* const p, gint64 v) {
+  v = GINT64_TO_LE(v);
+  memcpy(p, &v, sizeof(v));
+}
+
+// FNV-1a; only there to tell a torn record from a whole one.
+static guint32
+checksum(const guint8* p, gsize len) {
+  guint32 h = 2166136261u;
+  while (len--) {
+    h ^= *p++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static SEGMENT*
+segment_new(const gchar* const dir, const guint number) {
+  SEGMENT* const seg = g_new0(SEGMENT, 1);
+  gchar* const name = g_strdup_printf("%08u.log", number);
+  seg->number = number;
+  seg->fields = RECORD_FIELDS;
+  seg->path = g_build_filename(dir, name, NULL);
+  seg->index = g_array_new(FALSE, FALSE, sizeof(INDEX_ENTRY));
+  g_free(name);
+  return seg;
+}
+
+static void
+free_segment(gpointer data) {
+  SEGMENT* const seg = (SEGMENT*) data;
+  if (seg->mapped) g_mapped_file_unref(seg->mapped);
+  g_array_free(seg->index, TRUE);
+  g_free(seg->path);
+  g_free(seg);
+}
+
+static SEGMENT*
+last_segment(const HISTORY_LOG* const log) {
+  return log->segments->len
+    ? (SEGMENT*) g_ptr_array_index(log->segments, log->segments->len - 1) : NULL;
+}
+
+static void
+index_record(SEGMENT* const seg, const gint64 time, const guint32 offset) {
+  if (seg->records % INDEX_STRIDE == 0) {
+    const INDEX_ENTRY entry = { time, offset, seg->records };
+    g_array_append_val(seg->index, entry);
+  }
+  if (!seg->records) seg->first_time = time;
+  seg->last_time = time;
+  seg->records++;
+}
+
+// Length of the record at `offset`, or 0 if there is none. Records that
+// were never sealed into a segment are checked in full.
+static guint32
+record_length(const guint8* const data, const guint32 offset, const guint32 end,
+    const gint fields, const gboolean verify) {
+  if (end - offset < RECORD_HEADER_SIZE(fields)) return 0;
+  const guint32 length = get_u32(data + offset);
+  if (length < RECORD_HEADER_SIZE(fields) || length > end - offset || length % 8) return 0;
+  if (!verify) return length;
+
+  if (get_u32(data + offset + 4) != checksum(data + offset + 8, length - 8)) return 0;
+  guint64 used = RECORD_HEADER_SIZE(fields);
+  for (gint n = 0; n < fields; ++n) {
+    const guint32 size = get_u32(data + offset + 16 + 4 * n);
+    if (!size || (used += size) > length) return 0;
+    if (data[offset + used - 1] != '\0') return 0;
+  }
+  return length;
+}
+
+static void
+decode_record(const guint8* const p, const gint fields, HISTORY_RECORD* const record) {
+  const gchar** const values[RECORD_FIELDS] = {
+    &record->application_name, &record->title, &record->text,
+    &record->icon, &record->url, &record->received, &record->notification_name,
+  };
+  record->time = get_i64(p + 8);
+  const gchar* s = (const gchar*) p + RECORD_HEADER_SIZE(fields);
+  for (gint n = 0; n < RECORD_FIELDS; ++n) {
+    if (n >= fields) {
+      *values[n] = "";
+      continue;
+    }
+    *values[n] = s;
+    s += get_u32(p + 16 + 4 * n);
+  }
+}
+
+static void
+scan_segment(SEGMENT* const seg, const guint8* const data, const guint32 size) {
+  guint32 offset = SEGMENT_HEADER_SIZE;
+  guint32 length;
+  while ((length = record_length(data, offset, size, seg->fields, TRUE))) {
+    index_record(seg, get_i64(data + offset + 8), offset);
+    offset += length;
+  }
+  seg->end = offset;
+}
+
+static gboolean
+read_trailer(SEGMENT* const seg, const guint8* const data, const gsize size) {
+  if (size < SEGMENT_HEADER_SIZE + TRAILER_SIZE) return FALSE;
+  const guint8* const t = data + size - TRAILER_SIZE;
+  if (get_u32(t) != TRAILER_MAGIC) return FALSE;
+  const guint32 entries = get_u32(t + 4);
+  const guint32 index_offset = get_u32(t + 8);
+  if (index_offset < SEGMENT_HEADER_SIZE || index_offset > size - TRAILER_SIZE
+      || (size - TRAILER_SIZE - index_offset) / INDEX_ENTRY_SIZE != entries)
+    return FALSE;
+
+  seg->end = index_offset;
+  seg->records = get_u32(t + 12);
+  seg->first_time = get_i64(t + 16);
+  seg->last_time = get_i64(t + 24);
+  g_array_set_size(seg->index, entries);
+  for (guint32 n = 0; n < entries; ++n) {
+    const guint8* const p = data + index_offset + n * INDEX_ENTRY_SIZE;
+    INDEX_ENTRY* const entry = &g_array_index(seg->index, INDEX_ENTRY, n);
+    entry->time = get_i64(p);
+    entry->offset = get_u32(p + 8);
+    entry->ordinal = get_u32(p + 12);
+  }
+  seg->sealed = TRUE;
+  return TRUE;
+}
+
+// Fields per record, or 0 if this is not a segment.
+static gint
+segment_fields(const guint8* const data, const gsize size) {
+  if (size < SEGMENT_HEADER_SIZE || size > G_MAXUINT32) return 0;
+  if (!memcmp(data, SEGMENT_MAGIC, SEGMENT_HEADER_SIZE)) return RECORD_FIELDS;
+  if (!memcmp(data, SEGMENT_MAGIC_V1, SEGMENT_HEADER_SIZE)) return RECORD_FIELDS_V1;
+  return 0;
+}
+
+// Snapshots keep every segment mapped; the writer only keeps what it
+// needs for retention.
+static SEGMENT*
+load_segment(const gchar* const dir, const guint number, const gboolean keep_mapped) {
+  SEGMENT* const seg = segment_new(dir, number);
+  GMappedFile* const mapped = g_mapped_file_new(seg->path, FALSE, NULL);
+  const gsize size = mapped ? g_mapped_file_get_length(mapped) : 0;
+  const guint8* const data = mapped ? (const guint8*) g_mapped_file_get_contents(mapped) : NULL;
+  if (!(seg->fields = segment_fields(data, size))) {
+    if (mapped) g_mapped_file_unref(mapped);
+    free_segment(seg);
+    return NULL;
+  }
+
+  seg->bytes = size;
+  if (!read_trailer(seg, data, size)) scan_segment(seg, data, (guint32) size);
+  if (keep_mapped) {
+    seg->mapped = mapped;
+    seg->data = data;
+  } else {
+    g_mapped_file_unref(mapped);
+  }
+  return seg;
+}
+
+static gint
+compare_numbers(gconstpointer a, gconstpointer b) {
+  const guint x = *(const guint*) a, y = *(const guint*) b;
+  return x < y ? -1 : x > y;
+}
+
+// Segment numbers found in `dir`, oldest first.
+static GArray*
+list_segments(const gchar* const dir) {
+  GArray* const numbers = g_array_new(FALSE, FALSE, sizeof(guint));
+  GDir* const d = g_dir_open(dir, 0, NULL);
+  if (!d) return numbers;
+  const gchar* name;
+  while ((name = g_dir_read_name(d))) {
+    if (strlen(name) != 12 || !g_str_has_suffix(name, ".log")) continue;
+    gchar* end;
+    const guint number = (guint) strtoul(name, &end, 10);
+    if (end == name + 8) g_array_append_val(numbers, number);
+  }
+  g_dir_close(d);
+  g_array_sort(numbers, compare_numbers);
+  return numbers;
+}
+
+// Maps the last segment for appending, `capacity` bytes of it.
+static gboolean
+map_active(HISTORY_LOG* const log, SEGMENT* const seg, const guint32 capacity) {
+  const int fd = g_open(seg->path, O_RDWR | O_CREAT | O_BINARY, 0600);
+  if (fd < 0) return FALSE;
+#ifndef _WIN32
+  if (ftruncate(fd, capacity) < 0) {
+    close(fd);
+    return FALSE;
+  }
+# ifdef HAVE_POSIX_FALLOCATE
+  // Reserve the blocks now rather than on the first write to each page.
+  posix_fallocate(fd, 0, capacity);
+# endif
+  void* const base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return FALSE;
+  }
+  log->base = (guint8*) base;
+#else
+  // No mmap here; appends go to a buffer that is written out on flush.
+  log->base = (guint8*) g_malloc0(capacity);
+  if (seg->end) read(fd, log->base, seg->end);
+#endif
+  log->fd = fd;
+  log->capacity = capacity;
+  seg->bytes = capacity;
+
+  if (!seg->end) {
+    memcpy(log->base, SEGMENT_MAGIC, SEGMENT_HEADER_SIZE);
+    seg->end = SEGMENT_HEADER_SIZE;
+    log->synced = 0;
+  } else {
+    // Whatever a crash left past the last whole record.
+    memset(log->base + seg->end, 0, capacity - seg->end);
+    log->synced = seg->end;
+  }
+  return TRUE;
+}
+
+static void
+unmap_active(HISTORY_LOG* const log) {
+  if (!log->base) return;
+  history_log_flush(log);
+#ifndef _WIN32
+  munmap(log->base, log->capacity);
+#else
+  g_free(log->base);
+#endif
+  log->base = NULL;
+}
+
+#ifndef _WIN32
+// Writes the first `end` bytes of `fd`, then `tail`, to a new file that
+// replaces `path`. Snapshots may still have the old file mapped at its
+// full size; cutting that down in place would make them fault when they
+// read past the new end.
+static gboolean
+write_sealed(const int fd, const gchar* const path, const guint32 end,
+    const guint8* const tail, const gsize tail_len) {
+  gchar* const tmp = g_strconcat(path, ".tmp", NULL);
+  const int out = g_open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0600);
+  gboolean ok = out >= 0;
+  guint8* const buf = (guint8*) g_malloc(64 * 1024);
+  for (guint32 offset = 0; ok && offset < end;) {
+    const ssize_t r = pread(fd, buf, MIN(end - offset, 64 * 1024), offset);
+    ok = r > 0 && write(out, buf, r) == r;
+    offset += r;
+  }
+  g_free(buf);
+  ok = ok && write(out, tail, tail_len) == (ssize_t) tail_len && fsync(out) == 0;
+  if (out >= 0) close(out);
+  ok = ok && g_rename(tmp, path) == 0;
+  if (!ok) g_unlink(tmp);
+  g_free(tmp);
+  return ok;
+}
+#endif
+
+// Writes the index and trailer after the records and gives back the
+// space that was never used.
+static void
+seal_active(HISTORY_LOG* const log) {
+  SEGMENT* const seg = last_segment(log);
+  unmap_active(log);
+
+  const gsize len = seg->index->len * INDEX_ENTRY_SIZE + TRAILER_SIZE;
+  guint8* const buf = (guint8*) g_malloc(len);
+  for (guint n = 0; n < seg->index->len; ++n) {
+    const INDEX_ENTRY* const entry = &g_array_index(seg->index, INDEX_ENTRY, n);
+    guint8* const p = buf + n * INDEX_ENTRY_SIZE;
+    put_i64(p, entry->time);
+    put_u32(p + 8, entry->offset);
+    put_u32(p + 12, entry->ordinal);
+  }
+  guint8* const t = buf + len - TRAILER_SIZE;
+  put_u32(t, TRAILER_MAGIC);
+  put_u32(t + 4, seg->index->len);
+  put_u32(t + 8, seg->end);
+  put_u32(t + 12, seg->records);
+  put_i64(t + 16, seg->first_time);
+  put_i64(t + 24, seg->last_time);
+
+#ifndef _WIN32
+  if (!write_sealed(log->fd, seg->path, seg->end, buf, len))
+#else
+  if (lseek(log->fd, seg->end, SEEK_SET) < 0
+      || write(log->fd, buf, len) != (ssize_t) len
+      || ftruncate(log->fd, seg->end + len) < 0)
+#endif
+    g_warning("Can't seal history segment: %s", seg->path);
+  else
+    seg->sealed = TRUE;
+  seg->bytes = seg->end + len;
+  g_free(buf);
+  close(log->fd);
+  log->fd = -1;
+}
+
+static gboolean
+start_segment(HISTORY_LOG* const log, const guint32 length) {
+  const SEGMENT* const last = last_segment(log);
+  SEGMENT* const seg = segment_new(log->dir, last ? last->number + 1 : 1);
+  if (!map_active(log, seg, MAX(SEGMENT_BYTES, SEGMENT_HEADER_SIZE + length))) {
+    g_warning("Can't create history segment: %s", seg->path);
+    free_segment(seg);
+    return FALSE;
+  }
+  g_ptr_array_add(log->segments, seg);
+  return TRUE;
+}
+
+HISTORY_LOG*
+history_log_open(const gchar* const dir, const gboolean writable) {
+  if (writable && g_mkdir_with_parents(dir, 0700) < 0) {
+    g_critical("Can't create directory: %s", dir);
+    return NULL;
+  }
+
+  HISTORY_LOG* const log = g_new0(HISTORY_LOG, 1);
+  log->dir = g_strdup(dir);
+  log->writable = writable;
+  log->segments = g_ptr_array_new_with_free_func(free_segment);
+  log->fd = -1;
+
+  GArray* const numbers = list_segments(dir);
+  for (guint n = 0; n < numbers->len; ++n) {
+    SEGMENT* const seg = load_segment(dir, g_array_index(numbers, guint, n), !writable);
+    if (!seg) continue;
+    g_ptr_array_add(log->segments, seg);
+    log->records += seg->records;
+  }
+  g_array_free(numbers, TRUE);
+
+  // Carry on with a segment left open by the last run.
+  SEGMENT* const last = last_segment(log);
+  if (writable && last && !last->sealed && last->fields == RECORD_FIELDS
+      && !map_active(log, last, MAX((guint32) last->bytes, SEGMENT_BYTES)))
+    g_warning("Can't reopen history segment: %s", last->path);
+  return log;
+}
+
+void
+history_log_close(HISTORY_LOG* const log) {
+  if (!log) return;
+  unmap_active(log);
+  if (log->fd >= 0) close(log->fd);
+  g_ptr_array_free(log->segments, TRUE);
+  g_free(log->dir);
+  g_free(log);
+}
+
+gboolean
+history_log_append(HISTORY_LOG* const log, const HISTORY_RECORD* const record) {
+  if (!log->writable) return FALSE;
+  const gchar* const fields[RECORD_FIELDS] = {
+    record->application_name, record->title, record->text,
+    record->icon, record->url, record->received, record->notification_name,
+  };
+  guint32 sizes[RECORD_FIELDS];
+  gsize length = RECORD_HEADER_SIZE(RECORD_FIELDS);
+  for (gint n = 0; n < RECORD_FIELDS; ++n)
+    length += sizes[n] = strlen(fields[n] ? fields[n] : "") + 1;
+  length = (length + 7) & ~(gsize) 7;
+  if (length > G_MAXUINT32 / 2) return FALSE;
+
+  SEGMENT* seg = last_segment(log);
+  if (!log->base || seg->end + length > log->capacity) {
+    if (log->base) seal_active(log);
+    if (!start_segment(log, (guint32) length)) return FALSE;
+    seg = last_segment(log);
+  }
+
+  // The space is fresh, so the padding is already zero.
+  guint8* const p = log->base + seg->end;
+  put_i64(p + 8, record->time);
+  guint8* s = p + RECORD_HEADER_SIZE(RECORD_FIELDS);
+  for (gint n = 0; n < RECORD_FIELDS; ++n) {
+    put_u32(p + 16 + 4 * n, sizes[n]);
+    memcpy(s, fields[n] ? fields[n] : "", sizes[n]);
+    s += sizes[n];
+  }
+  put_u32(p + 4, checksum(p + 8, length - 8));
+  // The length goes in last: readers stop at the first record without one.
+  g_atomic_int_set((gint*) p, (gint) GUINT32_TO_LE((guint32) length));
+
+  index_record(seg, record->time, seg->end);
+  seg->end += length;
+  log->records++;
+  return TRUE;
+}
+
+void
+history_log_flush(HISTORY_LOG* const log) {
+  const SEGMENT* const seg = last_segment(log);
+  if (!log->base || seg->end <= log->synced) return;
+#ifndef _WIN32
+  const guint32 page = (guint32) sysconf(_SC_PAGESIZE);
+  const guint32 from = log->synced - log->synced % page;
+  msync(log->base + from, seg->end - from, MS_ASYNC);
+#else
+  if (lseek(log->fd, log->synced, SEEK_SET) < 0
+      || write(log->fd, log->base + log->synced, seg->end - log->synced) < 0)
+    return;
+#endif
+  log->synced = seg->end;
+}
+
+guint
+history_log_expire(HISTORY_LOG* const log, const gint64 before,
+    const guint64 max_rows, const guint64 max_bytes) {
+  if (!log->writable) return 0;
+  guint64 bytes = 0;
+  for (guint n = 0; n < log->segments->len; ++n)
+    bytes += ((SEGMENT*) g_ptr_array_index(log->segments, n))->bytes;
+
+  guint removed = 0;
+  // The last segment is never removed; it is the one being written.
+  while (log->segments->len > 1) {
+    const SEGMENT* const oldest = (SEGMENT*) g_ptr_array_index(log->segments, 0);
+    const gboolean expired = (before && oldest->last_time < before)
+      || (max_rows && log->records - oldest->records >= max_rows)
+      || (max_bytes && bytes - oldest->bytes >= max_bytes);
+    // Can fail where a snapshot still has it open; try again next time.
+    if (!expired || g_unlink(oldest->path) < 0) break;
+    removed += oldest->records;
+    log->records -= oldest->records;
+    bytes -= oldest->bytes;
+    g_ptr_array_remove_index(log->segments, 0);
+  }
+  return removed;
+}
+
+guint64
+history_log_count(HISTORY_LOG* const log) {
+  return log->records;
+}
+
+void
+history_log_foreach(HISTORY_LOG* const log, guint64 skip,
+    const history_log_func_t func, gpointer const user_data) {
+  // Records only link forward, so each stretch between two index entries
+  // is walked once to find them, then handed out backwards.
+  GArray* const offsets = g_array_sized_new(FALSE, FALSE, sizeof(guint32), INDEX_STRIDE);
+  for (guint n = log->segments->len; n--;) {
+    const SEGMENT* const seg = (SEGMENT*) g_ptr_array_index(log->segments, n);
+    if (!seg->data || !seg->records) continue;
+    if (skip >= seg->records) {
+      skip -= seg->records;
+      continue;
+    }
+    guint32 top = seg->records - 1 - (guint32) skip;
+    skip = 0;
+
+    for (guint e = MIN(top / INDEX_STRIDE + 1, seg->index->len); e--;) {
+      const INDEX_ENTRY* const entry = &g_array_index(seg->index, INDEX_ENTRY, e);
+      g_array_set_size(offsets, 0);
+      guint32 offset = entry->offset;
+      for (guint32 ordinal = entry->ordinal; ordinal <= top; ++ordinal) {
+        const guint32 length = record_length(seg->data, offset, seg->end, seg->fields, FALSE);
+        if (!length) break;
+        g_array_append_val(offsets, offset);
+        offset += length;
+      }
+      for (guint i = offsets->len; i--;) {
+        HISTORY_RECORD record;
+        decode_record(seg->data + g_array_index(offsets, guint32, i), seg->fields, &record);
+        if (!func(&record, user_data)) goto done;
+      }
+      top = entry->ordinal - 1;
+    }
+  }
+done:
+  g_array_free(offsets, TRUE);
+}
+
+void
+history_log_range(HISTORY_LOG* const log, const gint64 from, const gint64 to,
+    const history_log_func_t func, gpointer const user_data) {
+  for (guint n = 0; n < log->segments->len; ++n) {
+    const SEGMENT* const seg = (SEGMENT*) g_ptr_array_index(log->segments, n);
+    if (!seg->data || !seg->records || seg->last_time < from) continue;
+    if (seg->first_time >= to) return;
+
+    // Start at the last index entry before `from`.
+    guint lo = 0, hi = seg->index->len;
+    while (lo < hi) {
+      const guint mid = (lo + hi) / 2;
+      if (g_array_index(seg->index, INDEX_ENTRY, mid).time < from) lo = mid + 1;
+      else hi = mid;
+    }
+    guint32 offset = g_array_index(seg->index, INDEX_ENTRY, lo ? lo - 1 : 0).offset;
+    guint32 length;
+    while ((length = record_length(seg->data, offset, seg->end, seg->fields, FALSE))) {
+      HISTORY_RECORD record;
+      decode_record(seg->data + offset, seg->fields, &record);
+      if (record.time >= to) return;
+      if (record.time >= from && !func(&record, user_data)) return;
+      offset += length;
+    }
+  }
+}
+
+typedef struct {
+  gchar** words;
+  gint limit;
+  gint found;
+  history_func_t func;
+  gpointer user_data;
+} LOG_SEARCH;
+
+static gboolean
+search_record(const HISTORY_RECORD* const record, gpointer const data) {
+  LOG_SEARCH* const search = (LOG_SEARCH*) data;
+  gchar* const joined = g_strjoin("\n",
+      record->title, record->text, record->application_name, NULL);
+  gchar* const haystack = g_utf8_casefold(joined, -1);
+  gboolean matched = TRUE;
+  for (gint n = 0; matched && search->words[n]; ++n)
+    matched = strstr(haystack, search->words[n]) != NULL;
+  g_free(haystack);
+  g_free(joined);
+
+  if (matched) {
+    search->func(record->received, record->application_name,
+        record->title, record->text, search->user_data);
+    if (search->limit > 0 && ++search->found >= search->limit) return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean
+history_log_search(HISTORY_LOG* const log, const gchar* const query, const gint limit,
+    const history_func_t func, gpointer const user_data) {
+  // Substrings match anyway, so a trailing * needs no help.
+  GPtrArray* const words = g_ptr_array_new();
+  gchar** const split = g_strsplit_set(query, " \t\r\n", -1);
+  for (gint n = 0; split[n]; ++n) {
+    const gsize len = strlen(split[n]);
+    if (len && split[n][len - 1] == '*') split[n][len - 1] = '\0';
+    if (*split[n]) g_ptr_array_add(words, g_utf8_casefold(split[n], -1));
+  }
+  g_strfreev(split);
+  g_ptr_array_add(words, NULL);
+
+  LOG_SEARCH search = { (gchar**) words->pdata, limit, 0, func, user_data };
+  history_log_foreach(log, 0, search_record, &search);
+  g_strfreev((gchar**) g_ptr_array_free(words, FALSE));
+  return TRUE;
+}
+
+// vim:set et sw=2 ts=2 ai:
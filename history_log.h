@@ -0,0 +1,76 @@
+#ifndef history_log_h_
+#define history_log_h_
+
+#include <glib.h>
+
+#include "history.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// History kept as a directory of append-only segment files instead of the
+// notification table. Each segment is a run of length-prefixed records,
+// with a sparse index by time written at its end once it is full.
+typedef struct _HISTORY_LOG HISTORY_LOG;
+
+typedef struct {
+  gint64 time; // seconds since the epoch
+  const gchar* application_name;
+  const gchar* title;
+  const gchar* text;
+  const gchar* icon;
+  const gchar* url;
+  const gchar* received;
+  const gchar* notification_name; // "" in records from before it was kept
+} HISTORY_RECORD;
+
+// Return FALSE to stop. The record only lives for the call.
+typedef gboolean (*history_log_func_t)(const HISTORY_RECORD* record, gpointer user_data);
+
+// With `writable`, opens the log for the one process that appends to it,
+// creating `dir` if needed. Otherwise opens a snapshot of what had been
+// written so far; a missing directory reads as an empty log.
+HISTORY_LOG*
+history_log_open(const gchar* dir, gboolean writable);
+
+void
+history_log_close(HISTORY_LOG* log);
+
+gboolean
+history_log_append(HISTORY_LOG* log, const HISTORY_RECORD* record);
+
+// Starts writing back what was appended since the last call.
+void
+history_log_flush(HISTORY_LOG* log);
+
+// Deletes the oldest full segments while they are older than `before`, or
+// while the rest still hold `max_rows` and `max_bytes`; zero means no
+// limit. Works a segment at a time, so the log may exceed a limit by up
+// to one segment. Returns the number of records removed.
+guint
+history_log_expire(HISTORY_LOG* log, gint64 before, guint64 max_rows, guint64 max_bytes);
+
+guint64
+history_log_count(HISTORY_LOG* log);
+
+// Newest first, after skipping the `skip` newest.
+void
+history_log_foreach(HISTORY_LOG* log, guint64 skip,
+    history_log_func_t func, gpointer user_data);
+
+// Oldest first, those received from `from` up to but not including `to`.
+void
+history_log_range(HISTORY_LOG* log, gint64 from, gint64 to,
+    history_log_func_t func, gpointer user_data);
+
+// Same matching and order as history_search(), by scanning the records.
+gboolean
+history_log_search(HISTORY_LOG* log, const gchar* query, gint limit,
+    history_func_t func, gpointer user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* history_log_h_ */
@@ -0,0 +1,343 @@
+#include <gtk/gtk.h>
+#include <sqlite3.h>
+
+#include "gol.h"
+#include "history_model.h"
+#include "history_log.h"
+
+// Rows are read this many at a time, and this many pages are kept; about
+// a screenful of rows either side of what is visible.
+#define HISTORY_PAGE_ROWS 200
+#define HISTORY_CACHED_PAGES 8
+
+typedef struct {
+  gchar* columns[HISTORY_MODEL_COLUMNS];
+} HISTORY_ROW_DATA;
+
+typedef struct {
+  gint number;
+  guint len;
+  HISTORY_ROW_DATA rows[HISTORY_PAGE_ROWS];
+} HISTORY_PAGE;
+
+typedef struct {
+  GObject parent;
+  gint stamp;
+  sqlite3* db;
+  sqlite3_stmt* page_stmt;
+  HISTORY_LOG* log;     // instead of db, for the log backend
+  gint stored;          // rows in the table when the model was made
+  gint64 newest;        // number of the newest queued row among them
+  GPtrArray* fresh;     // HISTORY_ROW_DATA* prepended since, oldest first
+  GHashTable* pages;    // page number -> HISTORY_PAGE*
+  GQueue lru;           // page numbers, most recently used first
+  // Rowid of the first row of each page, 0 while unknown. A page that has
+  // been read tells where the next one starts, so scrolling only ever
+  // seeks on the primary key; only a jump uses an offset, from the
+  // closest page known.
+  GArray* anchors;
+} HISTORY_MODEL;
+
+typedef struct {
+  GObjectClass parent_class;
+} HISTORY_MODEL_CLASS;
+
+static GObjectClass* parent_class;
+
+#define HISTORY_MODEL_OF(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), history_model_get_type(), HISTORY_MODEL))
+
+static void
+free_row_data(HISTORY_ROW_DATA* const row) {
+  for (gint n = 0; n < HISTORY_MODEL_COLUMNS; ++n) g_free(row->columns[n]);
+}
+
+static void
+free_history_page(gpointer data) {
+  HISTORY_PAGE* const page = (HISTORY_PAGE*) data;
+  for (guint n = 0; n < page->len; ++n) free_row_data(&page->rows[n]);
+  g_free(page);
+}
+
+static void
+free_fresh_row(gpointer data) {
+  free_row_data((HISTORY_ROW_DATA*) data);
+  g_free(data);
+}
+
+static sqlite3_int64
+anchor_of(const HISTORY_MODEL* const hm, const gint number) {
+  return g_array_index(hm->anchors, sqlite3_int64, number);
+}
+
+static gboolean
+append_log_row(const HISTORY_RECORD* const record, gpointer const data) {
+  HISTORY_PAGE* const page = (HISTORY_PAGE*) data;
+  HISTORY_ROW_DATA* const row = &page->rows[page->len++];
+  row->columns[HISTORY_MODEL_RECEIVED] = g_strdup(record->received);
+  row->columns[HISTORY_MODEL_TITLE] = g_strdup(record->title);
+  row->columns[HISTORY_MODEL_TEXT] = g_strdup(record->text);
+  return page->len < HISTORY_PAGE_ROWS;
+}
+
+static HISTORY_PAGE*
+read_page(HISTORY_MODEL* const hm, const gint number) {
+  if (hm->log) {
+    HISTORY_PAGE* const page = g_new0(HISTORY_PAGE, 1);
+    page->number = number;
+    history_log_foreach(hm->log, (guint64) number * HISTORY_PAGE_ROWS, append_log_row, page);
+    return page;
+  }
+
+  gint from = number;
+  while (!anchor_of(hm, from)) from--;
+
+  HISTORY_PAGE* const page = g_new0(HISTORY_PAGE, 1);
+  page->number = number;
+  sqlite3_bind_int64(hm->page_stmt, 1, anchor_of(hm, from));
+  sqlite3_bind_int(hm->page_stmt, 2, HISTORY_PAGE_ROWS);
+  sqlite3_bind_int(hm->page_stmt, 3, (number - from) * HISTORY_PAGE_ROWS);
+  sqlite3_int64 rowid = 0;
+  while (page->len < HISTORY_PAGE_ROWS && sqlite3_step(hm->page_stmt) == SQLITE_ROW) {
+    rowid = sqlite3_column_int64(hm->page_stmt, 0);
+    if (!page->len) g_array_index(hm->anchors, sqlite3_int64, number) = rowid;
+    HISTORY_ROW_DATA* const row = &page->rows[page->len++];
+    for (gint n = 0; n < HISTORY_MODEL_COLUMNS; ++n)
+      row->columns[n] = g_strdup((const gchar*) sqlite3_column_text(hm->page_stmt, n + 1));
+  }
+  sqlite3_reset(hm->page_stmt);
+
+  if (page->len == HISTORY_PAGE_ROWS && (guint) number + 1 < hm->anchors->len && rowid > 1)
+    g_array_index(hm->anchors, sqlite3_int64, number + 1) = rowid - 1;
+  return page;
+}
+
+static HISTORY_PAGE*
+get_page(HISTORY_MODEL* const hm, const gint number) {
+  HISTORY_PAGE* page = (HISTORY_PAGE*) g_hash_table_lookup(hm->pages, GINT_TO_POINTER(number));
+  if (page) {
+    g_queue_remove(&hm->lru, GINT_TO_POINTER(number));
+  } else {
+    if (hm->lru.length >= HISTORY_CACHED_PAGES)
+      g_hash_table_remove(hm->pages, g_queue_pop_tail(&hm->lru));
+    page = read_page(hm, number);
+    g_hash_table_insert(hm->pages, GINT_TO_POINTER(number), page);
+  }
+  g_queue_push_head(&hm->lru, GINT_TO_POINTER(number));
+  return page;
+}
+
+// NULL if the row has been expired from the table since the snapshot.
+static const HISTORY_ROW_DATA*
+get_row(HISTORY_MODEL* const hm, const gint index) {
+  if ((guint) index < hm->fresh->len)
+    return (const HISTORY_ROW_DATA*) g_ptr_array_index(hm->fresh, hm->fresh->len - 1 - index);
+
+  const gint stored = index - hm->fresh->len;
+  const HISTORY_PAGE* const page = get_page(hm, stored / HISTORY_PAGE_ROWS);
+  const guint offset = stored % HISTORY_PAGE_ROWS;
+  return offset < page->len ? &page->rows[offset] : NULL;
+}
+
+static gint
+row_count(const HISTORY_MODEL* const hm) {
+  return hm->stored + hm->fresh->len;
+}
+
+static gboolean
+set_iter(const HISTORY_MODEL* const hm, GtkTreeIter* const iter, const gint index) {
+  if (index < 0 || index >= row_count(hm)) return FALSE;
+  iter->stamp = hm->stamp;
+  iter->user_data = GINT_TO_POINTER(index);
+  return TRUE;
+}
+
+static GtkTreeModelFlags
+history_model_get_flags(GtkTreeModel* GOL_UNUSED_ARG(model)) {
+  return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+history_model_get_n_columns(GtkTreeModel* GOL_UNUSED_ARG(model)) {
+  return HISTORY_MODEL_COLUMNS;
+}
+
+static GType
+history_model_get_column_type(GtkTreeModel* GOL_UNUSED_ARG(model), gint GOL_UNUSED_ARG(column)) {
+  return G_TYPE_STRING;
+}
+
+static gboolean
+history_model_get_iter(GtkTreeModel* model, GtkTreeIter* iter, GtkTreePath* path) {
+  if (gtk_tree_path_get_depth(path) != 1) return FALSE;
+  return set_iter(HISTORY_MODEL_OF(model), iter, gtk_tree_path_get_indices(path)[0]);
+}
+
+static GtkTreePath*
+history_model_get_path(GtkTreeModel* GOL_UNUSED_ARG(model), GtkTreeIter* iter) {
+  return gtk_tree_path_new_from_indices(GPOINTER_TO_INT(iter->user_data), -1);
+}
+
+static void
+history_model_get_value(GtkTreeModel* model, GtkTreeIter* iter, gint column, GValue* value) {
+  g_value_init(value, G_TYPE_STRING);
+  const HISTORY_ROW_DATA* const row =
+    get_row(HISTORY_MODEL_OF(model), GPOINTER_TO_INT(iter->user_data));
+  g_value_set_string(value, row ? row->columns[column] : "");
+}
+
+static gboolean
+history_model_iter_next(GtkTreeModel* model, GtkTreeIter* iter) {
+  return set_iter(HISTORY_MODEL_OF(model), iter, GPOINTER_TO_INT(iter->user_data) + 1);
+}
+
+static gboolean
+history_model_iter_children(GtkTreeModel* model, GtkTreeIter* iter, GtkTreeIter* parent) {
+  return !parent && set_iter(HISTORY_MODEL_OF(model), iter, 0);
+}
+
+static gboolean
+history_model_iter_has_child(GtkTreeModel* GOL_UNUSED_ARG(model), GtkTreeIter* GOL_UNUSED_ARG(iter)) {
+  return FALSE;
+}
+
+static gint
+history_model_iter_n_children(GtkTreeModel* model, GtkTreeIter* iter) {
+  return iter ? 0 : row_count(HISTORY_MODEL_OF(model));
+}
+
+static gboolean
+history_model_iter_nth_child(GtkTreeModel* model, GtkTreeIter* iter, GtkTreeIter* parent, gint n) {
+  return !parent && set_iter(HISTORY_MODEL_OF(model), iter, n);
+}
+
+static gboolean
+history_model_iter_parent(GtkTreeModel* GOL_UNUSED_ARG(model),
+    GtkTreeIter* GOL_UNUSED_ARG(iter), GtkTreeIter* GOL_UNUSED_ARG(child)) {
+  return FALSE;
+}
+
+static void
+history_model_tree_model_init(GtkTreeModelIface* iface) {
+  iface->get_flags = history_model_get_flags;
+  iface->get_n_columns = history_model_get_n_columns;
+  iface->get_column_type = history_model_get_column_type;
+  iface->get_iter = history_model_get_iter;
+  iface->get_path = history_model_get_path;
+  iface->get_value = history_model_get_value;
+  iface->iter_next = history_model_iter_next;
+  iface->iter_children = history_model_iter_children;
+  iface->iter_has_child = history_model_iter_has_child;
+  iface->iter_n_children = history_model_iter_n_children;
+  iface->iter_nth_child = history_model_iter_nth_child;
+  iface->iter_parent = history_model_iter_parent;
+}
+
+static void
+history_model_init(HISTORY_MODEL* hm) {
+  hm->stamp = g_random_int();
+  hm->fresh = g_ptr_array_new_with_free_func(free_fresh_row);
+  hm->pages = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_history_page);
+  g_queue_init(&hm->lru);
+  hm->anchors = g_array_new(FALSE, TRUE, sizeof(sqlite3_int64));
+}
+
+static void
+history_model_finalize(GObject* object) {
+  HISTORY_MODEL* const hm = HISTORY_MODEL_OF(object);
+  if (hm->page_stmt) sqlite3_finalize(hm->page_stmt);
+  history_log_close(hm->log);
+  g_ptr_array_free(hm->fresh, TRUE);
+  g_hash_table_destroy(hm->pages);
+  g_queue_clear(&hm->lru);
+  g_array_free(hm->anchors, TRUE);
+  parent_class->finalize(object);
+}
+
+static void
+history_model_class_init(HISTORY_MODEL_CLASS* klass) {
+  parent_class = (GObjectClass*) g_type_class_peek_parent(klass);
+  G_OBJECT_CLASS(klass)->finalize = history_model_finalize;
+}
+
+GType
+history_model_get_type() {
+  static GType type = 0;
+  if (!type) {
+    static const GTypeInfo info = {
+      sizeof(HISTORY_MODEL_CLASS),
+      NULL,
+      NULL,
+      (GClassInitFunc) history_model_class_init,
+      NULL,
+      NULL,
+      sizeof(HISTORY_MODEL),
+      0,
+      (GInstanceInitFunc) history_model_init,
+      NULL,
+    };
+    static const GInterfaceInfo tree_model_info = {
+      (GInterfaceInitFunc) history_model_tree_model_init,
+      NULL,
+      NULL,
+    };
+    type = g_type_register_static(G_TYPE_OBJECT, "GolHistoryModel", &info, 0);
+    g_type_add_interface_static(type, GTK_TYPE_TREE_MODEL, &tree_model_info);
+  }
+  return type;
+}
+
+GtkTreeModel*
+history_model_new(sqlite3* const db, const sqlite3_int64 top, const gint64 newest) {
+  HISTORY_MODEL* const hm = (HISTORY_MODEL*) g_object_new(history_model_get_type(), NULL);
+  hm->db = db;
+  hm->newest = newest;
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(db,
+        "select count(*) from notification where rowid <= ?", -1, &stmt, NULL) == SQLITE_OK) {
+    sqlite3_bind_int64(stmt, 1, top);
+    if (sqlite3_step(stmt) == SQLITE_ROW) hm->stored = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+  }
+  if (sqlite3_prepare_v2(db,
+        "select rowid, received, history_text(title), history_text(text) from notification"
+        " where rowid <= ? order by rowid desc limit ? offset ?",
+        -1, &hm->page_stmt, NULL) != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(db));
+    hm->stored = 0;
+  }
+
+  g_array_set_size(hm->anchors, (hm->stored + HISTORY_PAGE_ROWS - 1) / HISTORY_PAGE_ROWS + 1);
+  g_array_index(hm->anchors, sqlite3_int64, 0) = top;
+  return GTK_TREE_MODEL(hm);
+}
+
+GtkTreeModel*
+history_model_new_from_log(HISTORY_LOG* const log, const gint64 newest) {
+  HISTORY_MODEL* const hm = (HISTORY_MODEL*) g_object_new(history_model_get_type(), NULL);
+  hm->log = log;
+  hm->newest = newest;
+  hm->stored = log ? (gint) MIN(history_log_count(log), G_MAXINT) : 0;
+  return GTK_TREE_MODEL(hm);
+}
+
+void
+history_model_prepend(GtkTreeModel* const model, const gint64 serial,
+    const gchar* const received, const gchar* const title, const gchar* const text) {
+  HISTORY_MODEL* const hm = HISTORY_MODEL_OF(model);
+  if (serial <= hm->newest) return;
+  HISTORY_ROW_DATA* const row = g_new(HISTORY_ROW_DATA, 1);
+  row->columns[HISTORY_MODEL_RECEIVED] = g_strdup(received);
+  row->columns[HISTORY_MODEL_TITLE] = g_strdup(title);
+  row->columns[HISTORY_MODEL_TEXT] = g_strdup(text);
+  g_ptr_array_add(hm->fresh, row);
+
+  GtkTreeIter iter;
+  set_iter(hm, &iter, 0);
+  GtkTreePath* const path = gtk_tree_path_new_from_indices(0, -1);
+  gtk_tree_model_row_inserted(model, path, &iter);
+  gtk_tree_path_free(path);
+}
+
+// vim:set et sw=2 ts=2 ai:
@@ -0,0 +1,48 @@
+#ifndef history_model_h_
+#define history_model_h_
+
+#include <gtk/gtk.h>
+#include <sqlite3.h>
+
+#include "history_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Columns of the model, all strings.
+enum {
+  HISTORY_MODEL_RECEIVED,
+  HISTORY_MODEL_TITLE,
+  HISTORY_MODEL_TEXT,
+  HISTORY_MODEL_COLUMNS
+};
+
+GType
+history_model_get_type();
+
+// A flat list over the notification table, newest first, that only reads
+// the rows the view asks for. It holds the rows up to rowid `top`, which
+// history_snapshot() gives along with `newest`, the number of the last
+// queued row among them; rows queued after come in through
+// history_model_prepend(). Only use it on the thread that owns `db`, and
+// pair it with a tree view in fixed height mode, or the view will measure
+// every row.
+GtkTreeModel*
+history_model_new(sqlite3* db, sqlite3_int64 top, gint64 newest);
+
+// The same over a snapshot of the history log, which the model takes over.
+GtkTreeModel*
+history_model_new_from_log(HISTORY_LOG* log, gint64 newest);
+
+// Adds the row history_append() numbered `serial`, unless the snapshot
+// already has it.
+void
+history_model_prepend(GtkTreeModel* model, gint64 serial,
+    const gchar* received, const gchar* title, const gchar* text);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* history_model_h_ */
@@ -0,0 +1,143 @@
+#include <string.h>
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "gol.h"
+#include "icon_cache.h"
+#include "plugins/from_url.h"
+
+typedef struct {
+  gchar* key;
+  GdkPixbuf* pixbuf;
+  gsize bytes;
+  GList link; // in lru; data points back here
+} ICON_ENTRY;
+
+static GHashTable* icons; // key -> ICON_ENTRY*
+static GQueue lru;        // most recently used first
+static gsize budget;
+static gsize used;
+static guint hits;
+static guint misses;
+static guint evicted;
+G_LOCK_DEFINE_STATIC(icons);
+
+static void
+free_entry(gpointer data) {
+  ICON_ENTRY* const e = (ICON_ENTRY*) data;
+  g_object_unref(e->pixbuf);
+  g_free(e->key);
+  g_free(e);
+}
+
+void
+icon_cache_init(const gint bytes) {
+  G_LOCK(icons);
+  budget = (gsize) MAX(bytes, 0);
+  if (budget && !icons)
+    icons = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_entry);
+  G_UNLOCK(icons);
+}
+
+void
+icon_cache_term() {
+  G_LOCK(icons);
+  if (icons) g_hash_table_destroy(icons);
+  icons = NULL;
+  g_queue_init(&lru);
+  used = 0;
+  G_UNLOCK(icons);
+}
+
+static GdkPixbuf*
+load_icon(const gchar* const url, const gboolean local, const gint size) {
+  GdkPixbuf* const pixbuf = (local ? pixbuf_from_url_as_file : pixbuf_from_url)(url, NULL);
+  if (!pixbuf || size <= 0) return pixbuf;
+  GdkPixbuf* const scaled = gdk_pixbuf_scale_simple(pixbuf, size, size, GDK_INTERP_TILES);
+  if (!scaled) return pixbuf;
+  g_object_unref(pixbuf);
+  return scaled;
+}
+
+// Caller holds the lock.
+static void
+evict_over_budget() {
+  while (used > budget && lru.tail) {
+    ICON_ENTRY* const e = (ICON_ENTRY*) lru.tail->data;
+    g_queue_unlink(&lru, &e->link);
+    used -= e->bytes;
+    evicted++;
+    g_hash_table_remove(icons, e->key);
+  }
+}
+
+GdkPixbuf*
+icon_cache_get(const gchar* const url, const gboolean local, const gint size) {
+  if (!url || !*url) return NULL;
+  gchar* const key = g_strdup_printf("%d %c %s", MAX(size, 0), local ? 'f' : 'u', url);
+
+  G_LOCK(icons);
+  ICON_ENTRY* e = icons ? (ICON_ENTRY*) g_hash_table_lookup(icons, key) : NULL;
+  if (e) {
+    hits++;
+    g_queue_unlink(&lru, &e->link);
+    g_queue_push_head_link(&lru, &e->link);
+    GdkPixbuf* const pixbuf = (GdkPixbuf*) g_object_ref(e->pixbuf);
+    G_UNLOCK(icons);
+    g_free(key);
+    return pixbuf;
+  }
+  misses++;
+  G_UNLOCK(icons);
+
+  // Loaded without the lock, as it may mean a download. Another thread
+  // may load the same icon meanwhile; the first one in is kept.
+  GdkPixbuf* pixbuf = load_icon(url, local, size);
+  if (!pixbuf) {
+    g_free(key);
+    return NULL;
+  }
+  const gsize bytes = sizeof(ICON_ENTRY) + strlen(key) + 1
+    + (gsize) gdk_pixbuf_get_rowstride(pixbuf) * gdk_pixbuf_get_height(pixbuf);
+
+  G_LOCK(icons);
+  if (!icons || bytes > budget) {
+    G_UNLOCK(icons);
+    g_free(key);
+    return pixbuf;
+  }
+  e = (ICON_ENTRY*) g_hash_table_lookup(icons, key);
+  if (e) {
+    g_object_unref(pixbuf);
+    pixbuf = (GdkPixbuf*) g_object_ref(e->pixbuf);
+    G_UNLOCK(icons);
+    g_free(key);
+    return pixbuf;
+  }
+  e = g_new0(ICON_ENTRY, 1);
+  e->key = key;
+  e->pixbuf = (GdkPixbuf*) g_object_ref(pixbuf);
+  e->bytes = bytes;
+  e->link.data = e;
+  g_hash_table_insert(icons, e->key, e);
+  g_queue_push_head_link(&lru, &e->link);
+  used += bytes;
+  evict_over_budget();
+  G_UNLOCK(icons);
+  return pixbuf;
+}
+
+void
+icon_cache_stats(guint* const entries, gsize* const bytes,
+    guint* const hit_count, guint* const miss_count, guint* const evicted_count) {
+  G_LOCK(icons);
+  *entries = icons ? g_hash_table_size(icons) : 0;
+  *bytes = used;
+  *hit_count = hits;
+  *miss_count = misses;
+  *evicted_count = evicted;
+  G_UNLOCK(icons);
+}
+
+// vim:set et sw=2 ts=2 ai:
@@ -0,0 +1,33 @@
+#ifndef icon_cache_h_
+#define icon_cache_h_
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Icons as displays show them, decoded and scaled, least recently used
+// dropped first once they take more than `budget` bytes. Not positive
+// turns the cache off; every icon is then loaded each time.
+void
+icon_cache_init(gint budget);
+
+void
+icon_cache_term();
+
+// New reference to the icon at `url` scaled to `size` pixels square, or as
+// is if `size` is not positive. `local` as in NOTIFICATION_INFO. Loads it
+// on a miss; NULL if it can't be. Safe to call from any thread.
+GdkPixbuf*
+icon_cache_get(const gchar* url, gboolean local, gint size);
+
+void
+icon_cache_stats(guint* entries, gsize* bytes, guint* hits, guint* misses, guint* evicted);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* icon_cache_h_ */
@@ -0,0 +1,82 @@
+#include <glib.h>
+
+#include "gol.h"
+#include "recent.h"
+
+struct _RECENT_RING {
+  RECENT_ENTRY* entries;
+  guint size;
+  guint oldest; // index of the oldest entry
+  guint length;
+};
+
+RECENT_RING*
+recent_new(const guint size) {
+  RECENT_RING* const ring = g_new0(RECENT_RING, 1);
+  ring->size = MAX(size, 1);
+  ring->entries = g_new0(RECENT_ENTRY, ring->size);
+  return ring;
+}
+
+static void
+clear_entry(RECENT_ENTRY* const e) {
+  g_free(e->received);
+  g_free(e->application_name);
+  g_free(e->title);
+  g_free(e->text);
+}
+
+static void
+set_entry(RECENT_ENTRY* const e, const gchar* const received,
+    const gchar* const application_name, const gchar* const title, const gchar* const text) {
+  e->received = g_strdup(received ? received : "");
+  e->application_name = g_strdup(application_name ? application_name : "");
+  e->title = g_strdup(title ? title : "");
+  e->text = g_strdup(text ? text : "");
+}
+
+void
+recent_free(RECENT_RING* const ring) {
+  if (!ring) return;
+  for (guint n = 0; n < ring->length; ++n)
+    clear_entry(&ring->entries[(ring->oldest + n) % ring->size]);
+  g_free(ring->entries);
+  g_free(ring);
+}
+
+void
+recent_push(RECENT_RING* const ring, const gchar* const received,
+    const gchar* const application_name, const gchar* const title, const gchar* const text) {
+  RECENT_ENTRY* e;
+  if (ring->length < ring->size) {
+    e = &ring->entries[(ring->oldest + ring->length++) % ring->size];
+  } else {
+    e = &ring->entries[ring->oldest];
+    clear_entry(e);
+    ring->oldest = (ring->oldest + 1) % ring->size;
+  }
+  set_entry(e, received, application_name, title, text);
+}
+
+gboolean
+recent_push_oldest(RECENT_RING* const ring, const gchar* const received,
+    const gchar* const application_name, const gchar* const title, const gchar* const text) {
+  if (ring->length == ring->size) return FALSE;
+  ring->oldest = (ring->oldest + ring->size - 1) % ring->size;
+  ring->length++;
+  set_entry(&ring->entries[ring->oldest], received, application_name, title, text);
+  return ring->length < ring->size;
+}
+
+guint
+recent_length(const RECENT_RING* const ring) {
+  return ring ? ring->length : 0;
+}
+
+const RECENT_ENTRY*
+recent_get(const RECENT_RING* const ring, const guint index) {
+  if (!ring || index >= ring->length) return NULL;
+  return &ring->entries[(ring->oldest + ring->length - 1 - index) % ring->size];
+}
+
+// vim:set et sw=2 ts=2 ai:
@@ -0,0 +1,50 @@
+#ifndef recent_h_
+#define recent_h_
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  gchar* received;
+  gchar* application_name;
+  gchar* title;
+  gchar* text;
+} RECENT_ENTRY;
+
+// The last few notifications, in a ring of fixed size. Not thread-safe;
+// use it from one thread only.
+typedef struct _RECENT_RING RECENT_RING;
+
+RECENT_RING*
+recent_new(guint size);
+
+void
+recent_free(RECENT_RING* ring);
+
+// Adds the newest entry, dropping the oldest once full. The strings are
+// copied.
+void
+recent_push(RECENT_RING* ring, const gchar* received, const gchar* application_name,
+    const gchar* title, const gchar* text);
+
+// Adds an entry older than all those held, if there is room; for filling
+// the ring from the history, newest first. Returns FALSE once full.
+gboolean
+recent_push_oldest(RECENT_RING* ring, const gchar* received, const gchar* application_name,
+    const gchar* title, const gchar* text);
+
+guint
+recent_length(const RECENT_RING* ring);
+
+// 0 is the newest; NULL past the end.
+const RECENT_ENTRY*
+recent_get(const RECENT_RING* ring, guint index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* recent_h_ */
@@ -0,0 +1,118 @@
+#include <string.h>
+
+#include <glib.h>
+
+#include "gol.h"
+#include "rollup.h"
+
+typedef struct {
+  gint period;
+  gint minute;
+  gchar* application_name;
+  gchar* notification_name;
+  guint count;
+} ROLLUP_COUNTER;
+
+// Each counter is its own key. Only ever as big as the distinct
+// notifications seen between two drains.
+static GHashTable* counters;
+G_LOCK_DEFINE_STATIC(counters);
+
+static guint
+counter_hash(gconstpointer key) {
+  const ROLLUP_COUNTER* const c = (const ROLLUP_COUNTER*) key;
+  return (g_str_hash(c->application_name) * 31 + g_str_hash(c->notification_name)) * 31
+    + (guint) c->minute * 61 + (guint) c->period;
+}
+
+static gboolean
+counter_equal(gconstpointer a, gconstpointer b) {
+  const ROLLUP_COUNTER* const x = (const ROLLUP_COUNTER*) a;
+  const ROLLUP_COUNTER* const y = (const ROLLUP_COUNTER*) b;
+  return x->period == y->period && x->minute == y->minute
+    && !strcmp(x->application_name, y->application_name)
+    && !strcmp(x->notification_name, y->notification_name);
+}
+
+static void
+free_counter(gpointer data) {
+  ROLLUP_COUNTER* const c = (ROLLUP_COUNTER*) data;
+  g_free(c->application_name);
+  g_free(c->notification_name);
+  g_free(c);
+}
+
+static GHashTable*
+counters_new() {
+  return g_hash_table_new_full(counter_hash, counter_equal, free_counter, NULL);
+}
+
+void
+rollup_init() {
+  G_LOCK(counters);
+  if (!counters) counters = counters_new();
+  G_UNLOCK(counters);
+}
+
+void
+rollup_term() {
+  G_LOCK(counters);
+  if (counters) g_hash_table_destroy(counters);
+  counters = NULL;
+  G_UNLOCK(counters);
+}
+
+// Caller holds the lock.
+static void
+bump(const gint period, const gint minute,
+    const gchar* const application_name, const gchar* const notification_name) {
+  ROLLUP_COUNTER key = {
+    period, minute - minute % period,
+    (gchar*) application_name, (gchar*) notification_name, 0,
+  };
+  ROLLUP_COUNTER* c = (ROLLUP_COUNTER*) g_hash_table_lookup(counters, &key);
+  if (!c) {
+    c = g_new(ROLLUP_COUNTER, 1);
+    *c = key;
+    c->application_name = g_strdup(application_name);
+    c->notification_name = g_strdup(notification_name);
+    g_hash_table_insert(counters, c, c);
+  }
+  c->count++;
+}
+
+void
+rollup_count(const gchar* const application_name, const gchar* const notification_name,
+    const gint64 time) {
+  const gint minute = (gint) (time / 60);
+  const gchar* const app = application_name ? application_name : "";
+  const gchar* const name = notification_name ? notification_name : "";
+  G_LOCK(counters);
+  if (counters) {
+    bump(ROLLUP_MINUTE, minute, app, name);
+    bump(ROLLUP_HOUR, minute, app, name);
+  }
+  G_UNLOCK(counters);
+}
+
+guint
+rollup_drain(const rollup_func_t func, gpointer const user_data) {
+  G_LOCK(counters);
+  GHashTable* const drained = counters;
+  if (drained) counters = counters_new();
+  G_UNLOCK(counters);
+  if (!drained) return 0;
+
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, drained);
+  while (g_hash_table_iter_next(&iter, &key, NULL)) {
+    const ROLLUP_COUNTER* const c = (const ROLLUP_COUNTER*) key;
+    func(c->period, c->minute, c->application_name, c->notification_name, c->count, user_data);
+  }
+  const guint size = g_hash_table_size(drained);
+  g_hash_table_destroy(drained);
+  return size;
+}
+
+// vim:set et sw=2 ts=2 ai:
@@ -0,0 +1,40 @@
+#ifndef rollup_h_
+#define rollup_h_
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lengths of the periods counted, in minutes.
+#define ROLLUP_MINUTE 1
+#define ROLLUP_HOUR 60
+
+typedef void (*rollup_func_t)(gint period, gint minute,
+    const gchar* application_name, const gchar* notification_name,
+    guint count, gpointer user_data);
+
+void
+rollup_init();
+
+void
+rollup_term();
+
+// Counts one notification in the minute and the hour it arrived in, by
+// application and notification name. Safe to call from any thread.
+void
+rollup_count(const gchar* application_name, const gchar* notification_name,
+    gint64 time);
+
+// Hands each counter gathered since the last call to `func`, with the
+// first minute of its period (minutes since the epoch), then forgets
+// them. Counting carries on meanwhile. Returns the number of counters.
+guint
+rollup_drain(rollup_func_t func, gpointer user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* rollup_h_ */
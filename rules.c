@@ -0,0 +1,341 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "gol.h"
+#include "rules.h"
+
+#define RULES_ERROR (g_quark_from_static_string("gol-rules"))
+
+typedef enum {
+  RULE_DROP,
+  RULE_DISPLAY,
+  RULE_PRIORITY,
+  RULE_STICKY,
+} rule_action_t;
+
+typedef struct {
+  gchar* application_name;
+  gchar* notification_name;
+  GPatternSpec* source;
+  GRegex* title;
+  GRegex* text;
+  rule_action_t action;
+  gchar* display;
+  gint priority;
+} RULE;
+
+struct _RULE_SET {
+  GPtrArray* rules;
+  // Application name -> indexes of the rules that can match it, in order.
+  // Rules without app= are merged into every list, so one lookup gives the
+  // whole candidate set.
+  GHashTable* by_application;
+  GArray* any_application;
+};
+
+static void
+free_rule(gpointer data) {
+  RULE* const rule = (RULE*) data;
+  g_free(rule->application_name);
+  g_free(rule->notification_name);
+  if (rule->source) g_pattern_spec_free(rule->source);
+  if (rule->title) g_regex_unref(rule->title);
+  if (rule->text) g_regex_unref(rule->text);
+  g_free(rule->display);
+  g_free(rule);
+}
+
+static void
+free_index(gpointer data) {
+  g_array_free((GArray*) data, TRUE);
+}
+
+static const gchar*
+skip_blank(const gchar* p) {
+  while (*p == ' ' || *p == '\t') p++;
+  return p;
+}
+
+// Reads a bare word, a "quoted string" or a /regex/ with optional i flag.
+static gchar*
+read_value(const gchar** const pp, gboolean* const is_regex, gboolean* const caseless) {
+  const gchar* p = *pp;
+  *is_regex = *caseless = FALSE;
+
+  GString* const value = g_string_new(NULL);
+  if (*p == '"' || *p == '/') {
+    const gchar quote = *p++;
+    for (; *p && *p != quote; p++) {
+      if (*p == '\\' && p[1]) {
+        // Regex escapes are for GRegex, except the one for the delimiter.
+        if (quote == '/' && p[1] != '/') g_string_append_c(value, *p);
+        p++;
+      }
+      g_string_append_c(value, *p);
+    }
+    if (*p != quote) {
+      g_string_free(value, TRUE);
+      return NULL;
+    }
+    p++;
+    if (quote == '/') {
+      *is_regex = TRUE;
+      if (*p == 'i') {
+        *caseless = TRUE;
+        p++;
+      }
+    }
+  } else {
+    while (*p && !g_ascii_isspace(*p)) g_string_append_c(value, *p++);
+  }
+  *pp = p;
+  return g_string_free(value, FALSE);
+}
+
+static GRegex*
+compile_match(const gchar* const value, const gboolean is_regex,
+    const gboolean caseless, GError** const error) {
+  gchar* const pattern = is_regex ? g_strdup(value) : g_regex_escape_string(value, -1);
+  GRegex* const regex = g_regex_new(pattern,
+      G_REGEX_OPTIMIZE | (caseless ? G_REGEX_CASELESS : 0), 0, error);
+  g_free(pattern);
+  return regex;
+}
+
+static gboolean
+parse_condition(RULE* const rule, const gchar* const key, const gchar* const value,
+    const gboolean is_regex, const gboolean caseless, GError** const error) {
+  if (!strcmp(key, "title") || !strcmp(key, "text")) {
+    GRegex** const slot = key[1] == 'i' ? &rule->title : &rule->text;
+    if (*slot) goto twice;
+    return (*slot = compile_match(value, is_regex, caseless, error)) != NULL;
+  }
+
+  if (is_regex) {
+    g_set_error(error, RULES_ERROR, 0, "%s= takes a name, not a regex", key);
+    return FALSE;
+  }
+  if (!strcmp(key, "app")) {
+    if (rule->application_name) goto twice;
+    rule->application_name = g_strdup(value);
+  } else if (!strcmp(key, "name")) {
+    if (rule->notification_name) goto twice;
+    rule->notification_name = g_strdup(value);
+  } else if (!strcmp(key, "from")) {
+    if (rule->source) goto twice;
+    rule->source = g_pattern_spec_new(value);
+  } else {
+    g_set_error(error, RULES_ERROR, 0, "unknown condition %s=", key);
+    return FALSE;
+  }
+  return TRUE;
+
+twice:
+  g_set_error(error, RULES_ERROR, 0, "%s= given twice", key);
+  return FALSE;
+}
+
+static gboolean
+parse_action(RULE* const rule, const gchar* p, GError** const error) {
+  gboolean is_regex, caseless;
+  gchar* const verb = read_value(&p, &is_regex, &caseless);
+  gchar* arg = NULL;
+  gboolean ok = FALSE;
+
+  if (!verb) {
+    g_set_error(error, RULES_ERROR, 0, "unterminated value for action");
+    return FALSE;
+  }
+  p = skip_blank(p);
+  if (!strcmp(verb, "drop")) {
+    rule->action = RULE_DROP;
+  } else if (!strcmp(verb, "sticky")) {
+    rule->action = RULE_STICKY;
+  } else if (!strcmp(verb, "display") || !strcmp(verb, "priority")) {
+    if (!*p || !(arg = read_value(&p, &is_regex, &caseless)) || is_regex) {
+      g_set_error(error, RULES_ERROR, 0, "%s needs an argument", verb);
+      goto leave;
+    }
+    p = skip_blank(p);
+    if (verb[0] == 'd') {
+      rule->action = RULE_DISPLAY;
+      rule->display = g_strdup(arg);
+    } else {
+      char* end;
+      const long priority = strtol(arg, &end, 10);
+      if (*end || priority < -2 || priority > 2) {
+        g_set_error(error, RULES_ERROR, 0, "priority must be -2 to 2");
+        goto leave;
+      }
+      rule->action = RULE_PRIORITY;
+      rule->priority = (gint) priority;
+    }
+  } else {
+    g_set_error(error, RULES_ERROR, 0, "unknown action '%s'", verb);
+    goto leave;
+  }
+
+  if (*p) {
+    g_set_error(error, RULES_ERROR, 0, "unexpected '%s' after action", p);
+    goto leave;
+  }
+  ok = TRUE;
+
+leave:
+  g_free(verb);
+  g_free(arg);
+  return ok;
+}
+
+static RULE*
+parse_rule(const gchar* p, GError** const error) {
+  RULE* const rule = g_new0(RULE, 1);
+  for (;;) {
+    p = skip_blank(p);
+    if (!*p) {
+      g_set_error(error, RULES_ERROR, 0, "missing => and action");
+      goto fail;
+    }
+    if (p[0] == '=' && p[1] == '>') break;
+
+    const gchar* const key = p;
+    while (g_ascii_isalpha(*p)) p++;
+    if (p == key || *p != '=') {
+      g_set_error(error, RULES_ERROR, 0, "expected key=value at '%s'", key);
+      goto fail;
+    }
+    gchar* const name = g_strndup(key, p++ - key);
+
+    gboolean is_regex, caseless;
+    gchar* const value = read_value(&p, &is_regex, &caseless);
+    gboolean ok = FALSE;
+    if (value)
+      ok = parse_condition(rule, name, value, is_regex, caseless, error);
+    else
+      g_set_error(error, RULES_ERROR, 0, "unterminated value for %s=", name);
+    g_free(name);
+    g_free(value);
+    if (!ok) goto fail;
+  }
+
+  if (parse_action(rule, skip_blank(p + 2), error)) return rule;
+
+fail:
+  free_rule(rule);
+  return NULL;
+}
+
+static void
+build_index(RULE_SET* const rs) {
+  rs->any_application = g_array_new(FALSE, FALSE, sizeof(guint));
+  rs->by_application = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_index);
+
+  for (guint n = 0; n < rs->rules->len; ++n) {
+    const RULE* const rule = (const RULE*) g_ptr_array_index(rs->rules, n);
+    if (!rule->application_name) {
+      g_array_append_val(rs->any_application, n);
+      continue;
+    }
+    if (g_hash_table_lookup(rs->by_application, rule->application_name)) continue;
+
+    // First rule for this application: collect its list in one pass.
+    GArray* const order = g_array_new(FALSE, FALSE, sizeof(guint));
+    for (guint m = 0; m < rs->rules->len; ++m) {
+      const RULE* const other = (const RULE*) g_ptr_array_index(rs->rules, m);
+      if (!other->application_name || !strcmp(other->application_name, rule->application_name))
+        g_array_append_val(order, m);
+    }
+    g_hash_table_insert(rs->by_application, rule->application_name, order);
+  }
+}
+
+RULE_SET*
+rule_set_compile(const gchar* const source, GError** const error) {
+  RULE_SET* const rs = g_new0(RULE_SET, 1);
+  rs->rules = g_ptr_array_new_with_free_func(free_rule);
+
+  gchar** const lines = g_strsplit(source ? source : "", "\n", -1);
+  for (guint n = 0; lines[n]; ++n) {
+    const gchar* const line = skip_blank(g_strchomp(lines[n]));
+    if (!*line || *line == '#') continue;
+
+    GError* e = NULL;
+    RULE* const rule = parse_rule(line, &e);
+    if (!rule) {
+      g_set_error(error, RULES_ERROR, 0, "line %u: %s", n + 1, e->message);
+      g_error_free(e);
+      g_strfreev(lines);
+      rule_set_free(rs);
+      return NULL;
+    }
+    g_ptr_array_add(rs->rules, rule);
+  }
+  g_strfreev(lines);
+
+  build_index(rs);
+  return rs;
+}
+
+void
+rule_set_free(RULE_SET* const rs) {
+  if (!rs) return;
+  if (rs->by_application) g_hash_table_destroy(rs->by_application);
+  if (rs->any_application) g_array_free(rs->any_application, TRUE);
+  g_ptr_array_free(rs->rules, TRUE);
+  g_free(rs);
+}
+
+guint
+rule_set_size(const RULE_SET* const rs) {
+  return rs ? rs->rules->len : 0;
+}
+
+// Cheap string tests first; the regexes only run on what is left.
+static gboolean
+rule_matches(const RULE* const rule, const RULE_SUBJECT* const s) {
+  if (rule->notification_name && g_strcmp0(rule->notification_name, s->notification_name))
+    return FALSE;
+  if (rule->source && (!s->source || !g_pattern_match_string(rule->source, s->source)))
+    return FALSE;
+  if (rule->title && !g_regex_match(rule->title, s->title ? s->title : "", 0, NULL))
+    return FALSE;
+  if (rule->text && !g_regex_match(rule->text, s->text ? s->text : "", 0, NULL))
+    return FALSE;
+  return TRUE;
+}
+
+void
+rule_set_evaluate(const RULE_SET* const rs, const RULE_SUBJECT* const s, RULE_VERDICT* const verdict) {
+  memset(verdict, 0, sizeof(*verdict));
+
+  const GArray* order = s->application_name
+    ? (const GArray*) g_hash_table_lookup(rs->by_application, s->application_name)
+    : NULL;
+  if (!order) order = rs->any_application;
+
+  for (guint n = 0; n < order->len; ++n) {
+    const RULE* const rule =
+      (const RULE*) g_ptr_array_index(rs->rules, g_array_index(order, guint, n));
+    if (!rule_matches(rule, s)) continue;
+
+    switch (rule->action) {
+    case RULE_DROP:
+      verdict->drop = TRUE;
+      return;
+    case RULE_DISPLAY:
+      verdict->display = rule->display;
+      break;
+    case RULE_PRIORITY:
+      verdict->set_priority = TRUE;
+      verdict->priority = rule->priority;
+      break;
+    case RULE_STICKY:
+      verdict->sticky = TRUE;
+      break;
+    }
+  }
+}
+
+// vim:set et sw=2 ts=2 ai:
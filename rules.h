@@ -0,0 +1,58 @@
+#ifndef rules_h_
+#define rules_h_
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One rule per line, conditions first and a single action after "=>":
+//
+//   app="Build Bot" title=/fail(ed|ure)/i => display Balloon
+//   app=Twitter from=192.168.1.* => drop
+//   name=Alarm => priority 2
+//   text="on call" => sticky
+//
+// app and name match exactly, from is a glob on the sender address, title
+// and text take a /regex/ (optionally /regex/i) or a plain substring.
+// Blank lines and lines starting with '#' are ignored.
+
+typedef struct {
+  const gchar* application_name;
+  const gchar* notification_name;
+  const gchar* title;
+  const gchar* text;
+  const gchar* source;
+} RULE_SUBJECT;
+
+typedef struct {
+  gboolean drop;
+  const gchar* display; // owned by the rule set
+  gboolean set_priority;
+  gint priority;
+  gboolean sticky;
+} RULE_VERDICT;
+
+typedef struct _RULE_SET RULE_SET;
+
+// NULL with `error` set if any line is invalid; nothing is half compiled.
+RULE_SET*
+rule_set_compile(const gchar* source, GError** error);
+
+void
+rule_set_free(RULE_SET* rs);
+
+guint
+rule_set_size(const RULE_SET* rs);
+
+// Every matching rule applies in order, later ones winning; drop stops
+// evaluation right away.
+void
+rule_set_evaluate(const RULE_SET* rs, const RULE_SUBJECT* subject, RULE_VERDICT* verdict);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* rules_h_ */
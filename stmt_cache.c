@@ -0,0 +1,147 @@
+#include <string.h>
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#include "gol.h"
+#include "stmt_cache.h"
+
+typedef struct {
+  gchar* sql;          // template with ? placeholders, NULL if not cacheable
+  gchar* kinds;        // one of 'q' or 'd' per placeholder
+  sqlite3_stmt* idle;  // ready to use; NULL while checked out
+} STMT_TEMPLATE;
+
+struct _STMT_CACHE {
+  sqlite3* db;
+  GHashTable* templates; // template text -> STMT_TEMPLATE*
+  guint hits;
+  guint prepares;
+};
+
+// Statements are checked out while in use, so two threads never step the
+// same one; the lock only covers the table itself.
+G_LOCK_DEFINE_STATIC(stmt_cache);
+
+static void
+free_stmt_template(gpointer data) {
+  STMT_TEMPLATE* const tpl = (STMT_TEMPLATE*) data;
+  if (tpl->idle) sqlite3_finalize(tpl->idle);
+  g_free(tpl->sql);
+  g_free(tpl->kinds);
+  g_free(tpl);
+}
+
+static STMT_TEMPLATE*
+parse_template(const char* const tsql) {
+  STMT_TEMPLATE* const tpl = g_new0(STMT_TEMPLATE, 1);
+  GString* const sql = g_string_new(NULL);
+  GString* const kinds = g_string_new(NULL);
+
+  for (const char* p = tsql; *p; p++) {
+    if (!strncmp(p, "'%q'", 4)) {
+      g_string_append_c(sql, '?');
+      g_string_append_c(kinds, 'q');
+      p += 3;
+    } else if (!strncmp(p, "%d", 2)) {
+      g_string_append_c(sql, '?');
+      g_string_append_c(kinds, 'd');
+      p++;
+    } else if (!strncmp(p, "%%", 2)) {
+      g_string_append_c(sql, '%');
+      p++;
+    } else if (*p == '%') {
+      g_string_free(sql, TRUE);
+      g_string_free(kinds, TRUE);
+      return tpl;
+    } else {
+      g_string_append_c(sql, *p);
+    }
+  }
+  tpl->sql = g_string_free(sql, FALSE);
+  tpl->kinds = g_string_free(kinds, FALSE);
+  return tpl;
+}
+
+STMT_CACHE*
+stmt_cache_new(sqlite3* const db) {
+  STMT_CACHE* const cache = g_new0(STMT_CACHE, 1);
+  cache->db = db;
+  cache->templates = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_stmt_template);
+  return cache;
+}
+
+void
+stmt_cache_free(STMT_CACHE* const cache) {
+  if (!cache) return;
+  g_hash_table_destroy(cache->templates);
+  g_free(cache);
+}
+
+sqlite3_stmt*
+stmt_cache_acquire(STMT_CACHE* const cache, const char* const tsql, va_list args) {
+  G_LOCK(stmt_cache);
+  STMT_TEMPLATE* tpl = (STMT_TEMPLATE*) g_hash_table_lookup(cache->templates, tsql);
+  if (!tpl) {
+    tpl = parse_template(tsql);
+    g_hash_table_insert(cache->templates, g_strdup(tsql), tpl);
+  }
+  sqlite3_stmt* stmt = tpl->idle;
+  tpl->idle = NULL;
+  if (stmt) cache->hits++;
+  else cache->prepares++;
+  // Safe to use outside the lock: templates are never removed while the
+  // cache is alive, and these fields don't change after parsing.
+  const gchar* const sql = tpl->sql;
+  const gchar* const kinds = tpl->kinds;
+  G_UNLOCK(stmt_cache);
+
+  if (!sql) {
+    char* const formatted = sqlite3_vmprintf(tsql, args);
+    if (sqlite3_prepare_v2(cache->db, formatted, -1, &stmt, NULL) != SQLITE_OK)
+      gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(cache->db));
+    sqlite3_free(formatted);
+    return stmt;
+  }
+
+  if (!stmt && sqlite3_prepare_v2(cache->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    gol_debug_warning("sqlite3 reports an error.\n\t%s", sqlite3_errmsg(cache->db));
+    return NULL;
+  }
+
+  for (gint n = 0; kinds[n]; ++n) {
+    if (kinds[n] == 'q')
+      sqlite3_bind_text(stmt, n + 1, va_arg(args, const char*), -1, SQLITE_STATIC);
+    else
+      sqlite3_bind_int(stmt, n + 1, va_arg(args, int));
+  }
+  return stmt;
+}
+
+void
+stmt_cache_release(STMT_CACHE* const cache, const char* const tsql, sqlite3_stmt* const stmt) {
+  if (!stmt) return;
+
+  // Ready for the next caller; also drops references to the caller's strings.
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  G_LOCK(stmt_cache);
+  STMT_TEMPLATE* const tpl = (STMT_TEMPLATE*) g_hash_table_lookup(cache->templates, tsql);
+  const gboolean keep = tpl && tpl->sql && !tpl->idle;
+  if (keep) tpl->idle = stmt;
+  G_UNLOCK(stmt_cache);
+
+  // Uncacheable, or another thread used the same template meanwhile.
+  if (!keep) sqlite3_finalize(stmt);
+}
+
+void
+stmt_cache_stats(const STMT_CACHE* const cache, guint* const hits, guint* const prepares) {
+  G_LOCK(stmt_cache);
+  *hits = cache ? cache->hits : 0;
+  *prepares = cache ? cache->prepares : 0;
+  G_UNLOCK(stmt_cache);
+}
+
+// vim:set et sw=2 ts=2 ai:
@@ -0,0 +1,40 @@
+#ifndef stmt_cache_h_
+#define stmt_cache_h_
+
+#include <stdarg.h>
+
+#include <glib.h>
+#include <sqlite3.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _STMT_CACHE STMT_CACHE;
+
+STMT_CACHE*
+stmt_cache_new(sqlite3* db);
+
+// Finalizes every idle statement; call before sqlite3_close().
+void
+stmt_cache_free(STMT_CACHE* cache);
+
+// Prepared statement for a printf-style template with the arguments bound.
+// '%q' (quotes included) binds a string and %d an int; the template is only
+// parsed and prepared the first time it is seen. Templates using anything
+// else fall back to sqlite3_vmprintf and are prepared every time.
+// The statement belongs to the caller until stmt_cache_release().
+sqlite3_stmt*
+stmt_cache_acquire(STMT_CACHE* cache, const char* tsql, va_list args);
+
+void
+stmt_cache_release(STMT_CACHE* cache, const char* tsql, sqlite3_stmt* stmt);
+
+void
+stmt_cache_stats(const STMT_CACHE* cache, guint* hits, guint* prepares);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* stmt_cache_h_ */